@@ -52,7 +52,6 @@
 */
 
 #include "u_tid.h"
-#include "clock_srv.h"
 #include "blnk_srv.h"
 
 #include "config.h"
@@ -74,38 +73,43 @@
 #define GPIO_INSTANCE_PIN_NUMBER (23)
 
 static void blnksrv_init(void);
+static unsigned int blnksrv_flip(unsigned int pin_state);
+
+/* Flip the LED */
+static unsigned int
+blnksrv_flip(unsigned int pin_state)
+{
+    pin_state = (pin_state == GPIO_PIN_HIGH ? GPIO_PIN_LOW : GPIO_PIN_HIGH);
+    GPIOPinWrite(GPIO_INSTANCE_ADDRESS,
+		 GPIO_INSTANCE_PIN_NUMBER,
+		 pin_state);
+    return pin_state;
+}
 
 void
 blnksrv_main(void)
 {
-    int i;
-    int wakeup_time = 0;
-    int dbl_wu_time = 0;
+    int i, rc;
 
     blnksrv_init();
 
-    struct clkctx clock;
-    clkctx_init(&clock);
-
     unsigned int pin_state = GPIO_PIN_HIGH;
     unsigned int minute_counter = 0;
 
-    /* Get the initial time */
-    wakeup_time = Time(&clock);
+    /* Released by the kernel every 250 ms */
+    rc = SetPeriod(250 * 1000, 0);
+    assertv(rc, rc == 0);
 
     /* Blink Indefinately */
     while(1){
 
-	/* Delay 0.5 Seconds */
-	wakeup_time += 500;
-	DelayUntil(&clock, wakeup_time);
+	/* Delay 0.5 Seconds. A late release is still a release: the
+	   blink only slips if a whole period was missed. */
+	WaitPeriod();
+	WaitPeriod();
 
 	/* Flip the LED state */
-	pin_state = (pin_state == GPIO_PIN_HIGH ? GPIO_PIN_LOW : GPIO_PIN_HIGH);
-
-	GPIOPinWrite(GPIO_INSTANCE_ADDRESS,
-		     GPIO_INSTANCE_PIN_NUMBER,
-		     pin_state);
+	pin_state = blnksrv_flip(pin_state);
 
 	/* Double blink every minute */
 	minute_counter += 1;
@@ -113,20 +117,13 @@ blnksrv_main(void)
 	    assert(pin_state == GPIO_PIN_HIGH);
 
 	    /* Flip the LED every 250 ms 4 times */
-	    dbl_wu_time = wakeup_time;
 	    for(i = 0; i < 4; i++) {
-		dbl_wu_time += 250;
-		DelayUntil(&clock, dbl_wu_time);
-		pin_state = (pin_state == GPIO_PIN_HIGH ? GPIO_PIN_LOW : GPIO_PIN_HIGH);
-		GPIOPinWrite(GPIO_INSTANCE_ADDRESS,
-			     GPIO_INSTANCE_PIN_NUMBER,
-			     pin_state);
+		WaitPeriod();
+		pin_state = blnksrv_flip(pin_state);
 	    }
 	    assert(pin_state == GPIO_PIN_HIGH);
-	    assert(dbl_wu_time == wakeup_time + 1000);
 
 	    /* Set things up to go back to half second triggers */
-	    wakeup_time = dbl_wu_time;
 	    minute_counter = 2;
 	}
 	
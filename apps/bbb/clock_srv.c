@@ -75,34 +75,27 @@
 #define GPIO_INSTANCE_ADDRESS (SOC_GPIO_1_REGS)
 #define GPIO_INSTANCE_PIN_NUMBER (23)
 
-enum {
-    CLKMSG_TICK,
-    CLKMSG_TIME,
-    CLKMSG_DELAY,
-    CLKMSG_DELAYUNTIL
-};
-
-struct clkmsg {
-    int type;
-    int ticks;
-};
+/* One delay slot per task, then one per transaction (see SendAsync) */
+#define CLKSRV_SLOTS (MAX_TASKS + IPC_TXN_MAX)
 
 struct clksrv {
     /* Clock ticks in milliseconds */
     int ms_ticks;
 
-    tid_t              tids[MAX_TASKS];
-    struct pqueue      delays; /* TIDs' low bytes keyed on wakeup time */
-    struct pqueue_node delay_nodes[MAX_TASKS];
+    tid_t              tids[CLKSRV_SLOTS];
+    struct pqueue      delays; /* clients' slots keyed on wakeup time */
+    struct pqueue_node delay_nodes[CLKSRV_SLOTS];
 };
 
 static void clksrv_init(struct clksrv *clk);
-static void clksrv_notify(void);
 static void clksrv_cleanup(void);
-static int  clksrv_notify_cb(void*, size_t);
+static int  clksrv_tick_cb(void*, size_t);
+static int  clksrv_slot(tid_t who);
 static void clksrv_delayuntil(struct clksrv *clk, tid_t who, int ticks);
 static void clksrv_undelay(struct clksrv *clk);
 
+struct clkpage clk_page;
+
 static void 
 DMTimer3ModuleClkConfig(void)
 {
@@ -177,9 +170,12 @@ void
 clksrv_main(void)
 {
     struct clksrv clk;
-    struct clkmsg msg;
+    union {
+        struct clkmsg  clk;
+        struct evt_msg evt;
+    } msg;
     tid_t client;
-    int rc, rply;
+    int rc;
 
     clksrv_init(&clk);
 
@@ -187,29 +183,24 @@ clksrv_main(void)
     assertv(rc, rc == 0);
     for (;;) {
         rc = Receive(&client, &msg, sizeof (msg));
-        assert(rc == sizeof (msg));
-        switch (msg.type) {
-        case CLKMSG_TICK:
-            rc = Reply(client, NULL, 0);
-            assertv(rc, rc == 0);
-
-            clk.ms_ticks++;
-
+        if (client == EVT_TID(SYS_INT_TINT3)) {
+            /* Timer ticks come straight from the kernel */
+            assert(rc == sizeof (msg.evt));
+            clk.ms_ticks += msg.evt.count;
             clksrv_undelay(&clk);
-            break;
-        case CLKMSG_TIME:
-            rply = clk.ms_ticks;
-            rc = Reply(client, &rply, sizeof (rply));
-            assertv(rc, rc == 0);
-            break;
+            continue;
+        }
+
+        assert(rc == sizeof (msg.clk));
+        switch (msg.clk.type) {
         case CLKMSG_DELAY:
-            clksrv_delayuntil(&clk, client, clk.ms_ticks + msg.ticks);
+            clksrv_delayuntil(&clk, client, clk.ms_ticks + msg.clk.ticks);
             break;
         case CLKMSG_DELAYUNTIL:
-            clksrv_delayuntil(&clk, client, msg.ticks);
+            clksrv_delayuntil(&clk, client, msg.clk.ticks);
             break;
         default:
-            panic("unrecognized clock server message: %d", msg.type);
+            panic("unrecognized clock server message: %d", msg.clk.type);
         }
     }
 }
@@ -219,39 +210,23 @@ clksrv_init(struct clksrv *clk)
 {
     int rc;
     clk->ms_ticks = 0;
+    clk_page.ms_ticks = 0;
 
     pqueue_init(&clk->delays, ARRAY_SIZE(clk->delay_nodes), clk->delay_nodes);
-    rc = Create(PRIORITY_MAX, &clksrv_notify);
-    assertv(rc, rc >= 0);
-}
-
-static void
-clksrv_notify(void)
-{
-    tid_t         clksrv_tid;
-    struct clkmsg msg;
-    int rc;
 
-    //clksrv_cleanup();
     RegisterCleanup(&clksrv_cleanup);
 
     rc = clock_init();
     assertv(rc, rc == 0);
 
-    rc = RegisterEvent(SYS_INT_TINT3, &clksrv_notify_cb);
-    assert(rc == 0);
+    /* Receive ticks as messages, counted so none are lost while
+       we're busy with clients */
+    rc = RegisterEvent(
+        SYS_INT_TINT3, PRIORITY_MAX, EVT_MSG, &clksrv_tick_cb);
+    assertv(rc, rc == 0);
 
     /* Start timer */
     DMTimerEnable(SOC_DMTIMER_3_REGS);
-
-    clksrv_tid = WhoIs("clock");
-    for (;;) {
-        rc = AwaitEvent(NULL, 0);
-        assert(rc == 0);
-        msg.type = CLKMSG_TICK;
-        rc = Send(clksrv_tid, &msg, sizeof (msg), NULL, 0);
-        assert(rc == 0);
-    }
 }
 
 static void
@@ -261,10 +236,13 @@ clksrv_cleanup(void)
 }
 
 static int
-clksrv_notify_cb(void *ptr, size_t n)
+clksrv_tick_cb(void *ptr, size_t n)
 {
     assertv(ptr, ptr == NULL);
     assertv(n,   n   == 0);
+    /* Publish the tick. Only this callback writes the page. */
+    clk_page.ms_ticks++;
+
     /* Clear the timer interrupt */
     DMTimerIntDisable(SOC_DMTIMER_3_REGS, DMTIMER_INT_OVF_EN_FLAG);
     DMTimerIntStatusClear(SOC_DMTIMER_3_REGS, DMTIMER_INT_OVF_IT_FLAG);
@@ -272,14 +250,24 @@ clksrv_notify_cb(void *ptr, size_t n)
     return 0;
 }
 
+/* Where a client's delay is kept. A transaction's handle is no task's
+   index, so transactions get slots of their own. */
+static int
+clksrv_slot(tid_t who)
+{
+    if (IS_TXN_TID(who))
+        return MAX_TASKS + TXN_TID_HANDLE(who);
+    return who & 0xff;
+}
+
 static void
 clksrv_delayuntil(struct clksrv *clk, tid_t who, int when_ticks)
 {
     if (when_ticks > clk->ms_ticks) {
         /* Add to priority queue */
-        int rc;
-        clk->tids[who & 0xff] = who;
-        rc = pqueue_add(&clk->delays, who & 0xff, when_ticks);
+        int rc, slot = clksrv_slot(who);
+        clk->tids[slot] = who;
+        rc = pqueue_add(&clk->delays, slot, when_ticks);
         assertv(rc, rc == 0); /* we should always have enough space */
     } else {
         /* Reply immediately */
@@ -294,15 +282,23 @@ static void
 clksrv_undelay(struct clksrv *clk)
 {
     struct pqueue_entry *delay;
+    tid_t wake[CLKSRV_SLOTS];
+    int n, rc, rply;
+
+    n = 0;
     while ((delay = pqueue_peekmin(&clk->delays)) != NULL) {
-        int rc, rply;
         if (delay->key > clk->ms_ticks)
             break; /* no more tasks ready to wake up; all times in future */
-        rply = CLOCK_OK;
-        rc = Reply(clk->tids[delay->val], &rply, sizeof (rply));
-        assertv(rc, rc == 0);
+        wake[n++] = clk->tids[delay->val];
         pqueue_popmin(&clk->delays);
     }
+
+    /* Wake everyone whose time has come in a single trap */
+    if (n == 0)
+        return;
+    rply = CLOCK_OK;
+    rc = ReplyMulti(wake, n, &rply, sizeof (rply));
+    assertv(rc, rc == n);
 }
 
 void
@@ -311,15 +307,31 @@ clkctx_init(struct clkctx *ctx)
     ctx->clksrv_tid = WhoIs("clock");
 }
 
-int
-Time(struct clkctx *ctx)
+unsigned int
+TimeUs(struct clkctx *ctx)
 {
-    struct clkmsg msg;
-    int rc, rply;
-    msg.type = CLKMSG_TIME;
-    rc = Send(ctx->clksrv_tid, &msg, sizeof (msg), &rply, sizeof (rply));
-    assertv(rc, rc == sizeof (rply));
-    return rply;
+    unsigned int count, ovf;
+    int ms;
+    (void)ctx;
+
+    /* The timer reloads on overflow even while the tick IRQ waits to be
+       serviced (e.g. masked under a more important task), and only the
+       tick callback advances ms_ticks. A pending overflow is a tick
+       that has happened but isn't counted yet. Retry if a tick is
+       counted, or the timer overflows, between the reads. */
+    do {
+        ms    = clk_page.ms_ticks;
+        ovf   = DMTimerIntRawStatusGet(SOC_DMTIMER_3_REGS)
+              & DMTIMER_INT_OVF_IT_FLAG;
+        count = DMTimerCounterGet(SOC_DMTIMER_3_REGS);
+    } while (ms != clk_page.ms_ticks
+             || ovf != (DMTimerIntRawStatusGet(SOC_DMTIMER_3_REGS)
+                        & DMTIMER_INT_OVF_IT_FLAG));
+
+    if (ovf)
+        count += CLOCK_1ms;
+    return (unsigned int)ms * 1000
+        + (count - (CLOCK_OVF - CLOCK_1ms)) / CLOCK_1us;
 }
 
 int
@@ -334,6 +346,19 @@ Delay(struct clkctx *ctx, int ticks)
     return rply;
 }
 
+int
+DelayAsync(struct clkctx *ctx, int ticks, struct clkreq *req)
+{
+    req->msg.type  = CLKMSG_DELAY;
+    req->msg.ticks = ticks;
+    return SendAsync(
+        ctx->clksrv_tid,
+        &req->msg,
+        sizeof (req->msg),
+        &req->rply,
+        sizeof (req->rply));
+}
+
 int
 DelayUntil(struct clkctx *ctx, int when_ticks)
 {
@@ -80,16 +80,56 @@ void clksrv_main(void);
 /* Initialize a clock context. This blocks until the clock server starts. */
 void clkctx_init(struct clkctx *ctx);
 
-/* Get the current time */
-int Time(struct clkctx *ctx);
+/* The current tick count, kept up to date by the clock server's tick
+ * callback, which runs in the kernel on every tick. Any task may read
+ * it; only the callback writes it. */
+struct clkpage {
+    volatile int ms_ticks;
+};
+
+extern struct clkpage clk_page;
+
+/* Get the current time. This is a single load, with no message to the
+ * clock server. */
+static inline int
+Time(struct clkctx *ctx)
+{
+    (void)ctx;
+    return clk_page.ms_ticks;
+}
+
+/* Get the current time in microseconds, refined within the tick from
+ * the tick timer's count. Wraps after about 71 minutes. */
+unsigned int TimeUs(struct clkctx *ctx);
 
 /* Block for a given number of ticks. */
 int Delay(struct clkctx *ctx, int ticks);
 
+/* Start a Delay() without blocking, and return its SendAsync() handle.
+ * req must stay untouched until AwaitReply() returns the handle, and
+ * then req->rply holds what Delay() would have returned. */
+struct clkreq;
+int DelayAsync(struct clkctx *ctx, int ticks, struct clkreq *req);
+
 /* Block until a given time (in ticks). */
 int DelayUntil(struct clkctx *ctx, int when_ticks);
 
-/* Struct body */
+/* Struct bodies */
 struct clkctx {
     tid_t clksrv_tid;
 };
+
+enum {
+    CLKMSG_DELAY,
+    CLKMSG_DELAYUNTIL
+};
+
+struct clkmsg {
+    int type;
+    int ticks;
+};
+
+struct clkreq {
+    struct clkmsg msg;
+    int           rply;
+};
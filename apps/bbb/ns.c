@@ -175,7 +175,8 @@ static void
 ns_register(struct nsdb *db, const char name[NS_NAME_MAXLEN], tid_t tid)
 {
     struct nsrec *rec;
-    tid_t whois_client;
+    tid_t whois_clients[MAX_TASKS];
+    int n, rc;
 
     rec = ns_find_create(db, name, tid);
     if (rec == NULL) {
@@ -185,8 +186,15 @@ ns_register(struct nsdb *db, const char name[NS_NAME_MAXLEN], tid_t tid)
 
     rec->tid = tid;
     ns_reply(tid, NS_RPLY_SUCCESS);
-    while (nswait_trypop(db, &rec->waitq, &whois_client))
-        ns_reply(whois_client, tid);
+
+    /* Answer everyone who was waiting for this name at once */
+    n = 0;
+    while (nswait_trypop(db, &rec->waitq, &whois_clients[n]))
+        n++;
+    if (n > 0) {
+        rc = ReplyMulti(whois_clients, n, &tid, sizeof (tid));
+        assertv(rc, rc == n);
+    }
 }
 
 static void
@@ -244,11 +244,13 @@ bwformat ( const char *fmt, va_list va ) {
 	if ( ch != '%' )
 	    bwputc( ch );
 	else {
-	    lz = 0; w = 0;
+	    lz = ' '; w = 0;
 	    ch = *(fmt++);
 	    switch ( ch ) {
 	    case '0':
-		lz = 1; ch = *(fmt++);
+		lz = '0'; ch = *(fmt++);
+		if( ch >= '1' && ch <= '9' )
+		    ch = bwa2i( ch, &fmt, 10, &w );
 		break;
 	    case '1':
 	    case '2':
@@ -268,7 +270,7 @@ bwformat ( const char *fmt, va_list va ) {
 		bwputc( va_arg( va, char ) );
 		break;
 	    case 's':
-		bwputw( w, 0, va_arg( va, char* ) );
+		bwputw( w, ' ', va_arg( va, char* ) );
 		break;
 	    case 'u':
 		bwui2a( va_arg( va, unsigned int ), 10, bf );
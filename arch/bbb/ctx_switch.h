@@ -30,7 +30,23 @@ void     kern_entry_swi(void);
 void     kern_entry_irq(void);
 /* Kernel entry for undefined instructions */
 void     kern_entry_undef(void);
-/* Context switch into a task, return trap reason */
-uint32_t ctx_switch(struct task_desc *td);
+
+/* Context switch into a task, return trap reason.
+ *
+ * The switch code saves nothing but its return address, so every
+ * register but sp is declared clobbered here. The compiler then spills
+ * only the values that are actually live across the switch. */
+static inline uint32_t
+ctx_switch(struct task_desc *td)
+{
+    register uint32_t r0 __asm__ ("r0") = (uint32_t)td;
+    __asm__ volatile (
+        "bl ctx_switch_asm"
+        : "+r" (r0)
+        :
+        : "r1", "r2", "r3", "r4", "r5", "r6", "r7", "r8", "r9", "r10",
+          "r11", "ip", "lr", "cc", "memory");
+    return r0;
+}
 
 #endif
@@ -65,6 +65,7 @@
 
 #include "cp15.h"
 #include "ctx_switch.h"
+#include "fiq.h"
 #include "link.h"
 #include "exc_vec.h"
 
@@ -76,7 +77,6 @@ static void entry(void);
 //static void undef_inst_handler(void);
 static void prefetch_abort_handler(void);
 static void data_abort_handler(void);
-static void FIQ_handler(void);
 
 /* These are the things going into the exception vector table */
 static unsigned int const vecTbl[15] = 
@@ -95,7 +95,7 @@ static unsigned int const vecTbl[15] =
     (unsigned int)prefetch_abort_handler,
     (unsigned int)data_abort_handler,
     (unsigned int)kern_entry_irq,
-    (unsigned int)FIQ_handler
+    (unsigned int)kern_entry_fiq
 };
 
 /* Load vector table into memory */
@@ -157,11 +157,3 @@ data_abort_handler(void)
     bwputstr("Go fix it.\n\r");
     while(1);
 }
-
-/* Handle an FIQ */
-static void
-FIQ_handler(void)
-{
-    bwputstr("FIQ's are not supported on this system!\n\r");
-    while(1);
-}
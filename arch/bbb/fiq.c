@@ -0,0 +1,166 @@
+/*******************************************************************************
+    Copyright 2014 Matthew Thiffault
+
+    This file is part of HeatheRTOS.
+
+    HeatheRTOS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    HeatheRTOS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with HeatheRTOS.  If not, see <http://www.gnu.org/licenses/>.
+
+*******************************************************************************/
+
+#include "xbool.h"
+#include "xint.h"
+#include "xdef.h"
+#include "static_assert.h"
+#include "fiq.h"
+
+#include "xarg.h"
+#include "bwio.h"
+
+#include "intr.h"
+#include "soc_AM335x.h"
+#include "hw_intc.h"
+#include "hw_dmtimer.h"
+#include "interrupt.h"
+
+STATIC_ASSERT(fiq_buf_len_pow2, (FIQ_BUF_LEN & (FIQ_BUF_LEN - 1)) == 0);
+STATIC_ASSERT(fiq_sample_size, sizeof (struct fiq_sample) == 8);
+STATIC_ASSERT(fiq_head_ofs, offsetof(struct fiq_chan, head) == FIQ_CHAN_HEAD);
+STATIC_ASSERT(fiq_overruns_ofs,
+    offsetof(struct fiq_chan, overruns) == FIQ_CHAN_OVERRUNS);
+STATIC_ASSERT(fiq_timer_ofs, offsetof(struct fiq_chan, timer) == FIQ_CHAN_TIMER);
+STATIC_ASSERT(fiq_sample_ofs,
+    offsetof(struct fiq_chan, sample) == FIQ_CHAN_SAMPLE);
+STATIC_ASSERT(fiq_ack_ofs, offsetof(struct fiq_chan, ack) == FIQ_CHAN_ACK_REG);
+STATIC_ASSERT(fiq_ack_val_ofs,
+    offsetof(struct fiq_chan, ack_val) == FIQ_CHAN_ACK_VAL);
+STATIC_ASSERT(fiq_wake_ofs, offsetof(struct fiq_chan, wake) == FIQ_CHAN_WAKE_REG);
+STATIC_ASSERT(fiq_wake_bit_ofs,
+    offsetof(struct fiq_chan, wake_bit) == FIQ_CHAN_WAKE_BIT);
+STATIC_ASSERT(fiq_tail_ofs, offsetof(struct fiq_chan, tail) == FIQ_CHAN_TAIL);
+STATIC_ASSERT(fiq_buf_ofs, offsetof(struct fiq_chan, buf) == FIQ_CHAN_BUF);
+
+/* Called from fiq.S when a FIQ arrives with no channel attached */
+void fiq_unhandled(void);
+
+/* Set up a channel (user side) */
+void
+fiq_chan_init(
+    struct fiq_chan *chan,
+    volatile uint32_t *sample,
+    volatile uint32_t *ack,
+    uint32_t ack_val,
+    int wake_irq)
+{
+    chan->head     = 0;
+    chan->tail     = 0;
+    chan->overruns = 0;
+    chan->timer    = NULL;
+    chan->sample   = sample;
+    chan->ack      = ack;
+    chan->ack_val  = ack_val;
+    chan->wake     = NULL;
+    chan->wake_bit = 0;
+    chan->wake_irq = wake_irq;
+}
+
+/* How many samples are waiting? */
+unsigned int
+fiq_chan_count(struct fiq_chan *chan)
+{
+    return chan->head - chan->tail;
+}
+
+/* Pop the oldest sample */
+int
+fiq_chan_get(struct fiq_chan *chan, struct fiq_sample *out)
+{
+    uint32_t tail = chan->tail;
+    if (chan->head == tail)
+        return -1;
+
+    /* Read the sample only after seeing head move past it, and
+       release the slot only after the sample has been read. */
+    __asm__ volatile ("dmb":::"memory");
+    *out = chan->buf[tail & (FIQ_BUF_LEN - 1)];
+    __asm__ volatile ("dmb":::"memory");
+    chan->tail = tail + 1;
+    return 0;
+}
+
+/* Wake IRQ callback - runs in the kernel */
+int
+fiq_wake_cb(void *ptr, size_t size)
+{
+    struct fiq_chan *chan = ptr;
+    (void)size;
+    IntSoftwareIntClear(chan->wake_irq);
+    return (int)fiq_chan_count(chan);
+}
+
+/* Reset the FIQ path */
+void
+fiq_init(void)
+{
+    fiq_set_chan(NULL);
+    IntMasterFIQEnable();
+}
+
+/* Route an interrupt to the fast path */
+void
+fiq_attach(int irq, struct fiq_chan *chan)
+{
+    chan->timer = (volatile uint32_t*)(SOC_DMTIMER_2_REGS + DMTIMER_TCRR);
+    if (chan->wake_irq >= 0) {
+        chan->wake = (volatile uint32_t*)
+            (SOC_AINTC_REGS + INTC_ISR_SET(chan->wake_irq >> 5));
+        chan->wake_bit = 1u << (chan->wake_irq & 31);
+    }
+
+    /* Make the channel visible before the source can fire */
+    IntMasterFIQDisable();
+    fiq_set_chan(chan);
+    IntMasterFIQEnable();
+
+    /* Highest priority, routed to FIQ */
+    intr_config(irq, 0, true);
+    intr_enable(irq, true);
+}
+
+/* Return an interrupt to the normal IRQ path */
+void
+fiq_detach(int irq)
+{
+    intr_enable(irq, false);
+    intr_config(irq, 0, false);
+
+    IntMasterFIQDisable();
+    fiq_set_chan(NULL);
+    IntMasterFIQEnable();
+}
+
+/* Mask FIQs before leaving the kernel */
+void
+fiq_cleanup(void)
+{
+    IntMasterFIQDisable();
+    fiq_set_chan(NULL);
+}
+
+/* A FIQ arrived with nothing attached */
+void
+fiq_unhandled(void)
+{
+    bwputstr("FIQ with no channel attached!\n\r");
+    while(1);
+}
@@ -0,0 +1,132 @@
+/*******************************************************************************
+    Copyright 2014 Matthew Thiffault
+
+    This file is part of HeatheRTOS.
+
+    HeatheRTOS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    HeatheRTOS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with HeatheRTOS.  If not, see <http://www.gnu.org/licenses/>.
+
+*******************************************************************************/
+
+#ifndef FIQ_H
+#define FIQ_H
+
+/* FIQ fast path.
+ *
+ * Exactly one interrupt source may be routed to FIQ. Its handler never
+ * enters the kernel: it runs entirely on the FIQ banked registers,
+ * stamps the event with the raw debug timer count, optionally samples
+ * one device register, and pushes the pair into a single-producer
+ * single-consumer ring shared with the owning task. It can then pend a
+ * software IRQ so that the owner, blocked in AwaitEvent() on that IRQ,
+ * gets woken up through the normal event path.
+ *
+ * The offsets below are used by fiq.S and checked against the C struct
+ * in fiq.c. */
+
+/* Number of samples in a channel ring. Must be a power of two. */
+#define FIQ_BUF_LEN         64
+
+#define FIQ_CHAN_HEAD       0x00
+#define FIQ_CHAN_OVERRUNS   0x04
+#define FIQ_CHAN_TIMER      0x08
+#define FIQ_CHAN_SAMPLE     0x0c
+#define FIQ_CHAN_ACK_REG    0x10
+#define FIQ_CHAN_ACK_VAL    0x14
+#define FIQ_CHAN_WAKE_REG   0x18
+#define FIQ_CHAN_WAKE_BIT   0x1c
+#define FIQ_CHAN_TAIL       0x40
+#define FIQ_CHAN_BUF        0x80
+
+#ifndef __ASSEMBLER__
+
+#include "xint.h"
+#include "xdef.h"
+
+/* One captured event. The time is the raw debug timer count
+ * (3 counts per microsecond), not dbg_tmr_get() microseconds. */
+struct fiq_sample {
+    uint32_t time;
+    uint32_t value;
+};
+
+/* Channel shared between the FIQ handler (producer) and the owning
+ * task (consumer). The producer-written head and the consumer-written
+ * tail live on separate cache lines. */
+struct fiq_chan {
+    /* Written only by the FIQ handler */
+    volatile uint32_t  head;
+    volatile uint32_t  overruns;   /* samples dropped on a full ring */
+
+    /* Filled in by fiq_chan_init() */
+    volatile uint32_t *timer;      /* set by the kernel on registration */
+    volatile uint32_t *sample;     /* register to sample, or NULL */
+    volatile uint32_t *ack;        /* register written to clear the source */
+    uint32_t           ack_val;    /* value written to ack */
+    volatile uint32_t *wake;       /* set by the kernel on registration */
+    uint32_t           wake_bit;
+    int                wake_irq;   /* software IRQ to pend, or -1 */
+    uint32_t           pad0[7];
+
+    /* Written only by the consumer */
+    volatile uint32_t  tail;
+    uint32_t           pad1[15];
+
+    struct fiq_sample  buf[FIQ_BUF_LEN];
+} __attribute__((aligned(64)));
+
+/* Set up a channel before passing it to RegisterFiq().
+ * sample and ack may be NULL. wake_irq is an otherwise unused IRQ line
+ * to pend after each sample, or -1 for a polled channel. */
+void fiq_chan_init(
+    struct fiq_chan *chan,
+    volatile uint32_t *sample,
+    volatile uint32_t *ack,
+    uint32_t ack_val,
+    int wake_irq);
+
+/* Number of samples waiting in the channel. */
+unsigned int fiq_chan_count(struct fiq_chan *chan);
+
+/* Pop the oldest sample. Returns 0 on success, or -1 if empty. */
+int fiq_chan_get(struct fiq_chan *chan, struct fiq_sample *out);
+
+/* Event callback for the wake IRQ, for use with RegisterEvent() and
+ * AwaitEvent(chan, sizeof (*chan)). Clears the software interrupt and
+ * returns the number of samples waiting. */
+int fiq_wake_cb(void *chan, size_t size);
+
+/* Kernel side. */
+
+/* Reset the FIQ path and unmask FIQs on the CPU. No source is routed
+ * to FIQ until fiq_attach(). */
+void fiq_init(void);
+
+/* Route irq to FIQ and start capturing into chan. */
+void fiq_attach(int irq, struct fiq_chan *chan);
+
+/* Stop capturing and return irq to the IRQ path, disabled. */
+void fiq_detach(int irq);
+
+/* Mask FIQs on the CPU before handing the hardware back. */
+void fiq_cleanup(void);
+
+/* Load the channel pointer into the banked FIQ r8. (fiq.S) */
+void fiq_set_chan(struct fiq_chan *chan);
+
+/* FIQ vector entry point. (fiq.S) */
+void kern_entry_fiq(void);
+
+#endif
+
+#endif
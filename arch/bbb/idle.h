@@ -0,0 +1,37 @@
+/*******************************************************************************
+    Copyright 2014 Matthew Thiffault
+
+    This file is part of HeatheRTOS.
+
+    HeatheRTOS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    HeatheRTOS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with HeatheRTOS.  If not, see <http://www.gnu.org/licenses/>.
+
+*******************************************************************************/
+
+#ifndef IDLE_H
+#define IDLE_H
+
+#include "xint.h"
+
+/* Wait for an interrupt in a low power state (WFI). Usable from user
+ * mode. The debug timer is read into *sleep_start just before the WFI.
+ * The interrupt that ends the wait is taken with its return address
+ * at cpu_idle_wake, so the kernel can tell that the task it interrupted
+ * was asleep. An interrupt taken anywhere else in cpu_idle() may restart
+ * it from the top, to keep the stamp fresh. */
+void cpu_idle(volatile uint32_t *sleep_start);
+
+/* Address of the instruction following the WFI in cpu_idle(). */
+extern const char cpu_idle_wake[];
+
+#endif
@@ -63,6 +63,7 @@
 #include "bwio.h"
 
 #include "soc_AM335x.h"
+#include "hw_types.h"
 #include "hw_intc.h"
 #include "interrupt.h"
 
@@ -86,6 +87,20 @@ intr_config(int intr, unsigned int prio, bool fiq)
 		   fiq ? AINTC_HOSTINT_ROUTE_FIQ : AINTC_HOSTINT_ROUTE_IRQ);
 }
 
+/* Set the priority threshold below which IRQs are masked */
+void
+intr_threshold(unsigned int prio)
+{
+    IntPriorityThresholdSet(prio);
+}
+
+/* Check the raw (unmasked) status of an interrupt */
+bool
+intr_asserted(int intr)
+{
+    return IntRawStatusGet(intr) != 0;
+}
+
 /* Return the current highest priority interrupt */
 int
 intr_cur()
@@ -93,6 +108,28 @@ intr_cur()
     return IntActiveIrqNumGet();
 }
 
+/* Return the next interrupt that is still pending, if any */
+int
+intr_next(void)
+{
+    unsigned int i, sir;
+
+    /* Quick check for nothing pending at all */
+    for (i = 0; i < IRQ_COUNT / 32; i++) {
+        if (HWREG(SOC_AINTC_REGS + INTC_PENDING_IRQ(i)) != 0)
+            break;
+    }
+    if (i == IRQ_COUNT / 32)
+        return -1;
+
+    /* The INTC has re-sorted since the acknowledge. Anything below
+       the priority threshold shows up as spurious. */
+    sir = HWREG(SOC_AINTC_REGS + INTC_SIR_IRQ);
+    if (sir & INTC_SIR_IRQ_SPURIOUSIRQ)
+        return -1;
+    return sir & INTC_SIR_IRQ_ACTIVEIRQ;
+}
+
 /* Reset the interrupt controller */
 void
 intr_reset()
@@ -66,11 +66,26 @@ void intr_enable(int intr, bool enable);
 /* Set a given interrupt to be treated as FIQ or IRQ. */
 void intr_config(int intr, unsigned int prio, bool fiq);
 
+/* Mask every interrupt whose priority is numerically >= prio.
+ * Lower numbers are higher priority. Passing INTR_NO_THRESHOLD lets
+ * all interrupts through. */
+void intr_threshold(unsigned int prio);
+
+#define INTR_NO_THRESHOLD 0xff
+
+/* Is the given interrupt asserted, whether or not it is enabled? */
+bool intr_asserted(int intr);
+
 /* Get the lowest-numbered asserted IRQ.
  * IRQs should be infrequent enough that ordering doesn't matter.
  * Returns -1 if no IRQs are asserted. */
 int intr_cur();
 
+/* After intr_acknowledge(), get the next pending IRQ that would be
+ * delivered, or -1 if none. Lets the kernel drain several IRQs in a
+ * single entry. */
+int intr_next(void);
+
 /* Reset VIC state to default - all interrupts off, IRQ selected. */
 void intr_reset(void);
 
@@ -0,0 +1,113 @@
+/*******************************************************************************
+    Copyright 2014 Matthew Thiffault
+
+    This file is part of HeatheRTOS.
+
+    HeatheRTOS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    HeatheRTOS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with HeatheRTOS.  If not, see <http://www.gnu.org/licenses/>.
+
+*******************************************************************************/
+
+#include "xbool.h"
+#include "xint.h"
+#include "xdef.h"
+#include "static_assert.h"
+#include "ktimer.h"
+#include "section.h"
+
+#include "intr.h"
+#include "interrupt.h"
+#include "soc_AM335x.h"
+#include "hw_types.h"
+#include "hw_cm_per.h"
+#include "hw_cm_dpll.h"
+#include "dmtimer.h"
+
+STATIC_ASSERT(ktimer_irq, KTIMER_IRQ == SYS_INT_TINT4);
+
+#define KTIMER_OVF 0xffffffffu
+
+/* Clock DMTimer4 from the 24 MHz oscillator */
+static COLD void
+ktimer_clk_config(void)
+{
+    HWREG(SOC_CM_DPLL_REGS + CM_DPLL_CLKSEL_TIMER4_CLK) &=
+        ~(CM_DPLL_CLKSEL_TIMER4_CLK_CLKSEL);
+
+    HWREG(SOC_CM_DPLL_REGS + CM_DPLL_CLKSEL_TIMER4_CLK) |=
+        CM_DPLL_CLKSEL_TIMER4_CLK_CLKSEL_CLK_M_OSC;
+
+    while((HWREG(SOC_CM_DPLL_REGS + CM_DPLL_CLKSEL_TIMER4_CLK) &
+           CM_DPLL_CLKSEL_TIMER4_CLK_CLKSEL) !=
+          CM_DPLL_CLKSEL_TIMER4_CLK_CLKSEL_CLK_M_OSC);
+
+    HWREG(SOC_CM_PER_REGS + CM_PER_TIMER4_CLKCTRL) |=
+        CM_PER_TIMER4_CLKCTRL_MODULEMODE_ENABLE;
+
+    while((HWREG(SOC_CM_PER_REGS + CM_PER_TIMER4_CLKCTRL) &
+           CM_PER_TIMER4_CLKCTRL_MODULEMODE) != CM_PER_TIMER4_CLKCTRL_MODULEMODE_ENABLE);
+
+    while((HWREG(SOC_CM_PER_REGS + CM_PER_TIMER4_CLKCTRL) &
+           CM_PER_TIMER4_CLKCTRL_IDLEST) != CM_PER_TIMER4_CLKCTRL_IDLEST_FUNC);
+
+    while(!(HWREG(SOC_CM_PER_REGS + CM_PER_L4LS_CLKSTCTRL) &
+            (CM_PER_L4LS_CLKSTCTRL_CLKACTIVITY_L4LS_GCLK |
+             CM_PER_L4LS_CLKSTCTRL_CLKACTIVITY_TIMER4_GCLK)));
+}
+
+COLD void
+ktimer_init(void)
+{
+    ktimer_clk_config();
+    DMTimerDisable(SOC_DMTIMER_4_REGS);
+
+    /* 24 MHz / 8, as the debug timer */
+    DMTimerPreScalerClkEnable(SOC_DMTIMER_4_REGS, DMTIMER_PRESCALER_CLK_DIV_BY_8);
+    DMTimerModeConfigure(SOC_DMTIMER_4_REGS, DMTIMER_ONESHOT_NOCMP_ENABLE);
+    DMTimerIntStatusClear(SOC_DMTIMER_4_REGS, DMTIMER_INT_OVF_IT_FLAG);
+    DMTimerIntEnable(SOC_DMTIMER_4_REGS, DMTIMER_INT_OVF_EN_FLAG);
+
+    /* Above every task priority, so the threshold never masks it */
+    intr_config(KTIMER_IRQ, 0, false);
+    intr_enable(KTIMER_IRQ, true);
+}
+
+HOT void
+ktimer_arm(uint32_t ticks)
+{
+    DMTimerDisable(SOC_DMTIMER_4_REGS);
+    DMTimerCounterSet(SOC_DMTIMER_4_REGS, KTIMER_OVF - ticks + 1);
+    DMTimerEnable(SOC_DMTIMER_4_REGS);
+}
+
+HOT void
+ktimer_disarm(void)
+{
+    DMTimerDisable(SOC_DMTIMER_4_REGS);
+    DMTimerIntStatusClear(SOC_DMTIMER_4_REGS, DMTIMER_INT_OVF_IT_FLAG);
+}
+
+HOT void
+ktimer_ack(void)
+{
+    DMTimerIntStatusClear(SOC_DMTIMER_4_REGS, DMTIMER_INT_OVF_IT_FLAG);
+}
+
+COLD void
+ktimer_cleanup(void)
+{
+    DMTimerDisable(SOC_DMTIMER_4_REGS);
+    DMTimerIntDisable(SOC_DMTIMER_4_REGS, DMTIMER_INT_OVF_EN_FLAG);
+    DMTimerIntStatusClear(SOC_DMTIMER_4_REGS, DMTIMER_INT_OVF_IT_FLAG);
+    intr_enable(KTIMER_IRQ, false);
+}
@@ -0,0 +1,53 @@
+/*******************************************************************************
+    Copyright 2014 Matthew Thiffault
+
+    This file is part of HeatheRTOS.
+
+    HeatheRTOS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    HeatheRTOS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with HeatheRTOS.  If not, see <http://www.gnu.org/licenses/>.
+
+*******************************************************************************/
+
+#ifndef KTIMER_H
+#define KTIMER_H
+
+#include "xint.h"
+
+/*
+ * Kernel one-shot timer on DMTimer4, used to enforce CPU budgets. It
+ * counts in the same 3 MHz ticks as the debug timer (DBG_TMR_HZ). Its
+ * IRQ has the highest priority, so it can preempt any task, and it is
+ * handled by the kernel rather than routed to a task.
+ */
+
+#define KTIMER_IRQ 92 /* SYS_INT_TINT4 */
+
+/* No deadline: leave the timer stopped */
+#define KTIMER_NEVER 0xffffffffu
+
+/* Power up the timer and set up its IRQ. Leaves it stopped. */
+void ktimer_init(void);
+
+/* Raise KTIMER_IRQ after the given number of ticks (at least 1) */
+void ktimer_arm(uint32_t ticks);
+
+/* Stop the timer without raising its IRQ */
+void ktimer_disarm(void);
+
+/* Clear the IRQ, from the kernel's handler */
+void ktimer_ack(void);
+
+/* Stop the timer and mask its IRQ on kernel exit */
+void ktimer_cleanup(void);
+
+#endif
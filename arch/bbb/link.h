@@ -43,4 +43,22 @@ extern char _UndefInstrStackTop;
 #define UndefInstrStackBottom ((void*)(&_UndefInstrStackBottom))
 extern char _UndefInstrStackBottom;
 
+#define HotStart ((void*)(&_HotStart))
+extern char _HotStart;
+
+#define HotEnd ((void*)(&_HotEnd))
+extern char _HotEnd;
+
+#define ColdStart ((void*)(&_ColdStart))
+extern char _ColdStart;
+
+#define ColdEnd ((void*)(&_ColdEnd))
+extern char _ColdEnd;
+
+#define OcmcStacksStart ((void*)(&_OcmcStacksStart))
+extern char _OcmcStacksStart;
+
+#define OcmcStacksEnd ((void*)(&_OcmcStacksEnd))
+extern char _OcmcStacksEnd;
+
 #endif
@@ -0,0 +1,55 @@
+/*******************************************************************************
+    Copyright 2014 Matthew Thiffault
+
+    This file is part of HeatheRTOS.
+
+    HeatheRTOS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    HeatheRTOS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with HeatheRTOS.  If not, see <http://www.gnu.org/licenses/>.
+
+*******************************************************************************/
+
+#include "xint.h"
+#include "pmu.h"
+
+#define PMCR_E          0x1      /* enable all counters */
+#define PMCR_P          0x2      /* reset event counters */
+#define PMCR_C          0x4      /* reset cycle counter */
+#define PMCNTEN_C       (1u << 31)
+#define PMUSERENR_EN    0x1
+
+/* Cortex-A8 event numbers */
+#define EVT_L1I_REFILL  0x01
+#define EVT_L1D_REFILL  0x03
+
+static void
+pmu_event_setup(int counter, uint32_t event)
+{
+    __asm__ volatile ("mcr p15, 0, %0, c9, c12, 5" : : "r" (counter));
+    __asm__ volatile ("isb");
+    __asm__ volatile ("mcr p15, 0, %0, c9, c13, 1" : : "r" (event));
+}
+
+void
+pmu_init(void)
+{
+    uint32_t pmcr;
+    __asm__ volatile ("mrc p15, 0, %0, c9, c12, 0" : "=r" (pmcr));
+    pmcr |= PMCR_E | PMCR_P | PMCR_C;
+    __asm__ volatile ("mcr p15, 0, %0, c9, c12, 0" : : "r" (pmcr));
+    pmu_event_setup(PMU_DCACHE_MISS, EVT_L1D_REFILL);
+    pmu_event_setup(PMU_ICACHE_MISS, EVT_L1I_REFILL);
+    __asm__ volatile ("mcr p15, 0, %0, c9, c12, 1"
+        : : "r" (PMCNTEN_C | (1u << PMU_DCACHE_MISS) | (1u << PMU_ICACHE_MISS)));
+    __asm__ volatile ("mcr p15, 0, %0, c9, c14, 0" : : "r" (PMUSERENR_EN));
+    __asm__ volatile ("isb" : : : "memory");
+}
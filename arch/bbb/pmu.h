@@ -0,0 +1,64 @@
+/*******************************************************************************
+    Copyright 2014 Matthew Thiffault
+
+    This file is part of HeatheRTOS.
+
+    HeatheRTOS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    HeatheRTOS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with HeatheRTOS.  If not, see <http://www.gnu.org/licenses/>.
+
+*******************************************************************************/
+
+#ifndef PMU_H
+#define PMU_H
+
+#include "xint.h"
+
+/*
+ * Cortex-A8 performance monitor unit: the cycle counter, and two event
+ * counters set up to count cache misses.
+ */
+
+/* Event counters, see pmu_events() */
+enum {
+    PMU_DCACHE_MISS = 0, /* L1 data cache refills */
+    PMU_ICACHE_MISS = 1, /* L1 instruction cache refills */
+};
+
+/* Reset and start all counters, and allow user mode to read them.
+ * Must be called from a privileged mode. */
+void pmu_init(void);
+
+/* Read the cycle counter. Usable from user mode after pmu_init(). */
+static inline uint32_t
+pmu_cycles(void)
+{
+    uint32_t ccnt;
+    __asm__ volatile ("mrc p15, 0, %0, c9, c13, 0" : "=r" (ccnt));
+    return ccnt;
+}
+
+/* Read an event counter. Usable from user mode after pmu_init(). */
+static inline uint32_t
+pmu_events(int counter)
+{
+    uint32_t n;
+    __asm__ volatile (
+        "mcr p15, 0, %1, c9, c12, 5\n\t" /* PMSELR */
+        "isb\n\t"
+        "mrc p15, 0, %0, c9, c13, 2"      /* PMXEVCNTR */
+        : "=r" (n)
+        : "r" (counter));
+    return n;
+}
+
+#endif
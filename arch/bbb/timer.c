@@ -104,3 +104,9 @@ uint32_t dbg_tmr_get(void)
 {
     return (DMTimerCounterGet(SOC_DMTIMER_2_REGS) / 3);
 }
+
+/* Get the raw value of the debug timer (in 1/DBG_TMR_HZ s) */
+uint32_t dbg_tmr_ticks(void)
+{
+    return DMTimerCounterGet(SOC_DMTIMER_2_REGS);
+}
@@ -70,4 +70,13 @@ void dbg_tmr_reset(void);
 /* Get the current value of the debug timer. */
 uint32_t dbg_tmr_get(void);
 
+/* Raw debug timer ticks, which wrap cleanly at 32 bits */
+#define DBG_TMR_HZ 3000000
+#define DBG_TMR_TICKS_PER_US (DBG_TMR_HZ / 1000000)
+
+/* Longest interval, in us, that still compares correctly as a signed
+ * 32-bit difference of ticks */
+#define DBG_TMR_MAX_US (0x7fffffffu / DBG_TMR_TICKS_PER_US)
+uint32_t dbg_tmr_ticks(void);
+
 #endif
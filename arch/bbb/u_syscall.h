@@ -23,21 +23,162 @@
 
 #include "xdef.h"
 #include "u_tid.h"
+#include "event_flags.h"
+#include "budget_stats.h"
+#include "mbox_flags.h"
+#include "batch.h"
 
 tid_t Create(int priority, void (*task_entry)(void));
+
+/* OR into the priority given to Create() or CreateArg() to give a
+ * latency critical task a stack in on-chip RAM. These come from a small
+ * pool of OCMC_STACK_SIZE byte stacks; creation fails with -4 once the
+ * pool is used up. */
+#define CREATE_OCMC_STACK 0x100
+
+/* Create a task with an argument. size bytes at arg (at most
+ * TASK_ARG_MAX) are copied onto the new task's stack, and task_entry
+ * gets the copy. Returns -3 if size is too large, otherwise as Create(). */
+tid_t CreateArg(int priority, void (*task_entry)(void*, size_t),
+                const void *arg, size_t size);
+
 tid_t MyTid(void);
 tid_t MyParentTid(void);
 void  Pass(void);
 void  Exit(void) __attribute__((noreturn));
 
+/* Kill a task, as if it had called Exit(). Its pending Send()s are
+ * dropped, and tasks sending to it fail with -2. Returns 0, -1 for an
+ * impossible TID, -2 if there is no such task, or -3 for the idle task.
+ * A task in the middle of a long message copy goes once the copy is
+ * done. Destroying yourself doesn't return. */
+int   Destroy(tid_t tid);
+
 int   Send(int TID, const void* msg, int msglen, void* reply, int replylen);
 int   Receive(int* TID, void* msg, int msglen);
 int   Reply(int TID, const void* reply, int replylen);
 
+/* Send without waiting for the reply, so that several requests can be
+ * in flight at once. The receiver gets the message from the pseudo-TID
+ * TXN_TID(handle) (see u_tid.h), after any tasks blocked in Send(), and
+ * replies to that as usual. msg and reply must stay untouched until
+ * AwaitReply() returns the handle. Both lengths are limited to
+ * IPC_COPY_CHUNK. Returns a handle, -1 for an impossible TID, -2 if
+ * there is no such task, -3 if too many transactions are outstanding
+ * (IPC_TXN_MAX), or -4 for a bad length. */
+int   SendAsync(int TID, const void* msg, int msglen, void* reply, int replylen);
+
+/* Wait for any of n SendAsync() handles to be replied to, and return
+ * its index in handles. The handle is then used up; negative entries
+ * are skipped, so it can be overwritten with -1 and the array passed
+ * again. If result isn't NULL, it gets what Send() would have
+ * returned: the reply length, or -2 if the receiver exited first.
+ * Returns -1 if n is out of range or there are no handles to wait for,
+ * or -2 if one isn't an outstanding handle of this task. */
+int   AwaitReply(const int *handles, int n, int *result);
+
+/* Reply with the same message to each of n tasks, in one kernel entry.
+ * Returns the number of tasks replied to; TIDs that aren't waiting for
+ * a reply are skipped. Returns -1, replying to none, if replylen is
+ * over IPC_COPY_CHUNK. */
+int   ReplyMulti(const tid_t *tids, int n, const void* reply, int replylen);
+
 void  RegisterCleanup(void (*cleanup_cb)(void));
 
-int   RegisterEvent(int irq, int (*cb)(void*, size_t));
+/* Run n operations (see batch.h) in a single kernel entry. Returns 0
+ * with each op's rc filled in, -1 if n is negative, or if the last op
+ * blocks, that op's result. */
+int   Batch(struct batch_op *ops, int n);
+
+/* Register for an IRQ. The priority uses the task priority scale: the
+ * IRQ can only preempt tasks of equal or lower importance. flags is a
+ * combination of EVT_* flags (event_flags.h), or 0. A task may register
+ * several IRQs.
+ * AwaitEvent() waits for any of them and returns the callback's result,
+ * or for EVT_COUNT events the number of occurrences since the last
+ * return. AwaitAnyEvent() also reports which IRQ it was. When several
+ * are pending, they are returned round-robin. */
+int   RegisterEvent(int irq, int prio, unsigned int flags,
+                    int (*cb)(void*, size_t));
 int   AwaitEvent(void*, size_t);
+int   AwaitAnyEvent(void*, size_t, int *irq);
+
+/* Protect against interrupt storms on one of our events: after limit
+ * occurrences within window_us, the IRQ is masked until the window is
+ * over. Latched events (EVT_COUNT, EVT_MSG) then deliver the batch as
+ * one count. A limit of 1 coalesces to at most one per window; 0
+ * removes the limit. */
+int   SetEventLimit(int irq, unsigned int limit, unsigned int window_us);
+
+/* Read the counters of any registered event. */
+int   EventStats(int irq, struct evt_stats *stats);
+
+/* Limit a task to budget_us of CPU time per period_us. The period
+ * starts when the task first runs, and the full budget is restored
+ * when it ends. A task that uses up its budget is suspended until then,
+ * and the overrun is counted. A budget of 0 removes the limit. Returns
+ * 0, -1 for an impossible TID, -2 if there is no such task, or -3 for
+ * the idle task or a budget that doesn't fit in its period. */
+int   SetBudget(tid_t tid, unsigned int budget_us, unsigned int period_us);
+
+/* Read a task's budget and overrun count. Returns as SetBudget(). */
+int   BudgetStats(tid_t tid, struct budget_stats *stats);
+
+/* Block until another task calls Unpark() on us. If that has already
+ * happened since the last Park(), return right away instead: wakeups
+ * are never lost, but several before a Park() count as one. For use
+ * with shared memory, as in chan.h. Returns 0. */
+int   Park(void);
+
+/* Wake a task from Park(), or make its next Park() return immediately.
+ * Returns 0, -1 for an impossible TID, or -2 if there is no such task. */
+int   Unpark(tid_t tid);
+
+/* Make this task periodic, with releases every period_us starting
+ * offset_us from now. A period of 0 removes it. Returns 0, or -1 if
+ * either time is over about 715 seconds. */
+int   SetPeriod(unsigned int period_us, unsigned int offset_us);
+
+/* Block until this task's next release. Returns 0 if it was reached in
+ * time. If it has already passed, returns at once with the number of
+ * releases missed since (the one being started is not counted) and
+ * resynchronizes to the next release after now. Returns -1 if the task
+ * has no period. */
+int   WaitPeriod(void);
+
+/* Run as the given job of the cyclic executive (see cyclic.h): block
+ * until the start of the job's next slot. The first call claims the
+ * job. Returns the number of slots overrun since the last call, -1 if
+ * there is no schedule or no such job, or -2 if the job belongs to
+ * another task or this task already has one. */
+int   CyclicWait(int job);
+
+/* Create a mailbox (see mbox.h) holding messages of up to msg_max
+ * bytes in size bytes of mem, which must be word aligned and stay
+ * valid for as long as the kernel runs. policy is an MBOX_* overflow
+ * policy (mbox_flags.h). Returns the mailbox ID, -1 for a bad
+ * argument, -2 if mem can't hold even one message, or -3 if there are
+ * no mailboxes left. */
+int   MboxCreate(void *mem, int size, int msg_max, int policy);
+
+/* Queue a message in a mailbox, without blocking. Returns 0, 1 if the
+ * oldest message was dropped to make room (MBOX_OVERWRITE), -1 for no
+ * such mailbox, -2 if len is over its msg_max, or -3 if it is full
+ * (MBOX_REJECT). */
+int   Post(int mbox, const void *msg, int len);
+
+/* Take the oldest message from a mailbox, blocking until there is one.
+ * A message longer than len is truncated. Returns its full length, -1
+ * for no such mailbox, or -2 if len is negative. */
+int   Fetch(int mbox, void *buf, int len);
+
+/* Route an IRQ to the FIQ fast path, capturing into chan (see fiq.h).
+ * Set chan up with fiq_chan_init() first. To block for samples,
+ * RegisterEvent() the channel's wake IRQ with fiq_wake_cb and call
+ * AwaitEvent(chan, sizeof (*chan)). Returns 0, or one of the errors
+ * listed for evt_register_fiq() in event.h. */
+struct fiq_chan;
+int   RegisterFiq(int irq, struct fiq_chan *chan);
 
 /* Instruct the kernel to shut down immediately. */
 void Shutdown(void) __attribute__((noreturn));
@@ -0,0 +1,54 @@
+/*******************************************************************************
+    Copyright 2014 Matthew Thiffault
+
+    This file is part of HeatheRTOS.
+
+    HeatheRTOS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    HeatheRTOS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with HeatheRTOS.  If not, see <http://www.gnu.org/licenses/>.
+
+*******************************************************************************/
+
+#ifndef BATCH_H
+#define BATCH_H
+
+/* Operations for the Batch() system call. Shared by the kernel and
+ * tasks.
+ *
+ * A batch is an array of operations executed in order in a single
+ * kernel entry. Non-blocking operations store their result in rc.
+ * A blocking operation (BATCH_RECEIVE, BATCH_AWAITEVENT) may only be
+ * the last one in the batch; Batch() then returns its result as the
+ * corresponding system call would. */
+enum {
+    BATCH_REPLY,        /* Reply(tid, buf, len) */
+    BATCH_RECEIVE,      /* Receive(&tid, buf, len) - last only */
+    BATCH_AWAITEVENT,   /* AwaitEvent(buf, len) - last only */
+    BATCH_POST          /* Post(tid, buf, len), with tid the mailbox */
+};
+
+/* Per-operation errors */
+enum {
+    BATCH_BAD_OP   = -16, /* unknown operation */
+    BATCH_NOT_LAST = -17, /* blocking operation before the end */
+    BATCH_TOO_LONG = -18  /* BATCH_REPLY longer than IPC_COPY_CHUNK */
+};
+
+struct batch_op {
+    int   op;   /* BATCH_* */
+    int   tid;  /* BATCH_REPLY: client; BATCH_RECEIVE: sender (out) */
+    void *buf;
+    int   len;
+    int   rc;   /* result, filled in by the kernel */
+};
+
+#endif
@@ -57,6 +57,14 @@ ctz32(uint32_t x)
     return tz;
 }
 
+/* Count leading zeros of a nonzero 32 bit number. This is a single
+ * instruction on ARMv5 and later. */
+static inline int
+clz32(uint32_t x)
+{
+    return __builtin_clz(x);
+}
+
 /* Bit reverse an 8-bit number */
 static inline uint8_t
 bitrev8(uint8_t n)
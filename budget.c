@@ -0,0 +1,219 @@
+/*******************************************************************************
+    Copyright 2014 Matthew Thiffault
+
+    This file is part of HeatheRTOS.
+
+    HeatheRTOS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    HeatheRTOS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with HeatheRTOS.  If not, see <http://www.gnu.org/licenses/>.
+
+*******************************************************************************/
+
+#include "config.h"
+#include "xbool.h"
+#include "xint.h"
+#include "xdef.h"
+#include "static_assert.h"
+#include "u_tid.h"
+#include "task.h"
+#include "event.h"
+#include "kern.h"
+#include "budget.h"
+
+#include "xassert.h"
+#include "section.h"
+#include "timer.h"
+#include "ktimer.h"
+
+#define BUDGET_NONE  0x7fffffff
+
+static void budget_restore(struct task_budget *b, uint32_t now);
+
+COLD void
+budget_init(struct kern *kern)
+{
+    int i;
+    kern->budget.throttled = 0;
+    kern->budget.next_repl = 0;
+    for (i = 0; i < MAX_TASKS; i++)
+        budget_reset(kern, TASK_IX2PTR(kern, i));
+}
+
+void
+budget_reset(struct kern *kern, struct task_desc *td)
+{
+    struct task_budget *b = &kern->budget.tasks[TASK_PTR2IX(kern, td)];
+    b->left     = BUDGET_NONE;
+    b->budget   = 0;
+    b->period   = 0;
+    b->repl_at  = 0;
+    b->overruns = 0;
+    b->started  = false;
+}
+
+bool
+budget_throttle(struct kern *kern, struct task_desc *td, uint32_t now)
+{
+    struct task_budget *b = &kern->budget.tasks[TASK_PTR2IX(kern, td)];
+
+    assert(b->budget != 0 && b->started);
+    if ((int32_t)(now - b->repl_at) >= 0) {
+        budget_restore(b, now);
+        return false;
+    }
+
+    b->overruns++;
+    TASK_SET_STATE(kern, td, TASK_STATE_THROTTLED);
+    if (kern->budget.throttled++ == 0
+        || (int32_t)(b->repl_at - kern->budget.next_repl) < 0)
+        kern->budget.next_repl = b->repl_at;
+    return true;
+}
+
+void
+budget_replenish(struct kern *kern, uint32_t now)
+{
+    int i, left;
+    uint32_t next = now;
+    bool first = true;
+
+    if (kern->budget.throttled == 0
+        || (int32_t)(now - kern->budget.next_repl) < 0)
+        return;
+
+    left = kern->budget.throttled;
+    for (i = 0; i < MAX_TASKS && left > 0; i++) {
+        struct task_desc *td = TASK_IX2PTR(kern, i);
+        struct task_budget *b = &kern->budget.tasks[i];
+        if (TASK_STATE(kern, td) != TASK_STATE_THROTTLED)
+            continue;
+        left--;
+        if ((int32_t)(now - b->repl_at) >= 0) {
+            budget_restore(b, now);
+            kern->budget.throttled--;
+            task_ready(kern, td);
+        } else if (first || (int32_t)(b->repl_at - next) < 0) {
+            next  = b->repl_at;
+            first = false;
+        }
+    }
+    kern->budget.next_repl = next;
+}
+
+HOT uint32_t
+budget_next(struct kern *kern, struct task_desc *td, uint32_t now)
+{
+    struct task_budget *b = &kern->budget.tasks[TASK_PTR2IX(kern, td)];
+    uint32_t ticks = KTIMER_NEVER;
+
+    if (b->budget != 0)
+        ticks = b->left > 0 ? b->left : 1;
+    if (kern->budget.throttled > 0) {
+        int32_t until = kern->budget.next_repl - now;
+        if (until < 1)
+            until = 1;
+        if ((uint32_t)until < ticks)
+            ticks = until;
+    }
+    return ticks;
+}
+
+HOT void
+budget_charge(
+    struct kern *kern,
+    struct task_desc *td,
+    uint32_t start,
+    uint32_t now)
+{
+    struct task_budget *b = &kern->budget.tasks[TASK_PTR2IX(kern, td)];
+
+    if (b->budget == 0)
+        return;
+
+    /* A new period begins with the first run after the last one ended */
+    if (!b->started || (int32_t)(start - b->repl_at) >= 0)
+        budget_restore(b, start);
+    b->left -= now - start;
+}
+
+void
+budget_forget(struct kern *kern, struct task_desc *td)
+{
+    assert(TASK_STATE(kern, td) == TASK_STATE_THROTTLED);
+    kern->budget.throttled--;
+}
+
+int
+budget_set(
+    struct kern *kern,
+    tid_t tid,
+    unsigned int budget_us,
+    unsigned int period_us)
+{
+    struct task_desc *td;
+    struct task_budget *b;
+    int rc;
+
+    rc = get_task(kern, tid, &td);
+    if (rc != GET_TASK_SUCCESS)
+        return rc;
+
+    if (TASK_PTR2IX(kern, td) == 0)
+        return -3; /* the idle task must always be able to run */
+    if (budget_us != 0
+        && (period_us == 0
+            || period_us > DBG_TMR_MAX_US
+            || budget_us > period_us))
+        return -3;
+
+    b = &kern->budget.tasks[TASK_PTR2IX(kern, td)];
+    b->budget  = budget_us * DBG_TMR_TICKS_PER_US;
+    b->period  = period_us * DBG_TMR_TICKS_PER_US;
+    b->left    = budget_us != 0 ? (int32_t)b->budget : BUDGET_NONE;
+    b->started = false;
+
+    /* A new budget applies right away */
+    if (TASK_STATE(kern, td) == TASK_STATE_THROTTLED) {
+        kern->budget.throttled--;
+        task_ready(kern, td);
+    }
+    return 0;
+}
+
+int
+budget_stats(struct kern *kern, tid_t tid, struct budget_stats *out)
+{
+    struct task_desc *td;
+    struct task_budget *b;
+    int rc;
+
+    rc = get_task(kern, tid, &td);
+    if (rc != GET_TASK_SUCCESS)
+        return rc;
+
+    b = &kern->budget.tasks[TASK_PTR2IX(kern, td)];
+    out->budget_us = b->budget / DBG_TMR_TICKS_PER_US;
+    out->period_us = b->period / DBG_TMR_TICKS_PER_US;
+    out->left_us   = b->budget != 0 ? b->left / DBG_TMR_TICKS_PER_US : 0;
+    out->overruns  = b->overruns;
+    out->throttled = TASK_STATE(kern, td) == TASK_STATE_THROTTLED;
+    return 0;
+}
+
+/* Start a new period with the full budget */
+static void
+budget_restore(struct task_budget *b, uint32_t now)
+{
+    b->left    = b->budget;
+    b->repl_at = now + b->period;
+    b->started = true;
+}
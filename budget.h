@@ -0,0 +1,99 @@
+/*******************************************************************************
+    Copyright 2014 Matthew Thiffault
+
+    This file is part of HeatheRTOS.
+
+    HeatheRTOS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    HeatheRTOS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with HeatheRTOS.  If not, see <http://www.gnu.org/licenses/>.
+
+*******************************************************************************/
+
+#ifndef BUDGET_H
+#define BUDGET_H
+
+#include "xbool.h"
+#include "xint.h"
+#include "u_tid.h"
+#include "config.h"
+#include "budget_stats.h"
+
+/*
+ * Per-task CPU budgets. A task with a budget may run for at most
+ * budget ticks in each period. The period starts when the task first
+ * runs with a full budget, and the whole budget is restored when it
+ * ends, as for a sporadic server with a single replenishment. A task
+ * that runs out is taken off the CPU by the kernel timer and put in
+ * TASK_STATE_THROTTLED until then.
+ *
+ * Times are in debug timer ticks (DBG_TMR_HZ).
+ */
+
+struct kern;
+struct task_desc;
+
+struct task_budget {
+    int32_t  left;     /* INT32_MAX when there is no budget */
+    uint32_t budget;   /* 0 for no budget */
+    uint32_t period;
+    uint32_t repl_at;  /* end of the current period, if started */
+    uint32_t overruns;
+    bool     started;  /* a period is under way */
+};
+
+struct budgets {
+    int                throttled; /* tasks in TASK_STATE_THROTTLED */
+    uint32_t           next_repl; /* earliest repl_at of those tasks */
+    struct task_budget tasks[MAX_TASKS];
+};
+
+/* Has the task used up its budget? Checked when it's scheduled. */
+#define BUDGET_EXHAUSTED(kern, td) \
+    ((kern)->budget.tasks[TASK_PTR2IX(kern, td)].left <= 0)
+
+/* Initialize budget state */
+void budget_init(struct kern *kern);
+
+/* Remove any budget from a new task */
+void budget_reset(struct kern *kern, struct task_desc *td);
+
+/* Throttle a just-scheduled task whose budget is used up. Returns
+ * false if the budget was due for replenishment anyway, and the task
+ * can run. */
+bool budget_throttle(struct kern *kern, struct task_desc *td, uint32_t now);
+
+/* Ready throttled tasks whose periods are over */
+void budget_replenish(struct kern *kern, uint32_t now);
+
+/* Ticks until the kernel timer is needed for budgets, with the given
+ * task about to run, or KTIMER_NEVER */
+uint32_t budget_next(struct kern *kern, struct task_desc *td, uint32_t now);
+
+/* Charge a task for running from start to now */
+void budget_charge(
+    struct kern *kern,
+    struct task_desc *td,
+    uint32_t start,
+    uint32_t now);
+
+/* Take a throttled task out of the count, on Destroy() */
+void budget_forget(struct kern *kern, struct task_desc *td);
+
+/* SetBudget() and BudgetStats(). Return 0 or a negative error. */
+int budget_set(
+    struct kern *kern,
+    tid_t tid,
+    unsigned int budget_us,
+    unsigned int period_us);
+int budget_stats(struct kern *kern, tid_t tid, struct budget_stats *out);
+
+#endif
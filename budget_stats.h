@@ -0,0 +1,34 @@
+/*******************************************************************************
+    Copyright 2014 Matthew Thiffault
+
+    This file is part of HeatheRTOS.
+
+    HeatheRTOS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    HeatheRTOS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with HeatheRTOS.  If not, see <http://www.gnu.org/licenses/>.
+
+*******************************************************************************/
+
+#ifndef BUDGET_STATS_H
+#define BUDGET_STATS_H
+
+/* A task's CPU budget, returned by BudgetStats(). Shared by the kernel
+ * and tasks. */
+struct budget_stats {
+    unsigned int budget_us; /* per period, 0 for no limit */
+    unsigned int period_us;
+    int          left_us;   /* remaining in this period, may be < 0 */
+    unsigned int overruns;  /* times the task was throttled */
+    int          throttled; /* non-zero while waiting for replenishment */
+};
+
+#endif
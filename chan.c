@@ -0,0 +1,132 @@
+/*******************************************************************************
+    Copyright 2014 Matthew Thiffault
+
+    This file is part of HeatheRTOS.
+
+    HeatheRTOS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    HeatheRTOS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with HeatheRTOS.  If not, see <http://www.gnu.org/licenses/>.
+
+*******************************************************************************/
+
+#include "xbool.h"
+#include "xint.h"
+#include "xdef.h"
+#include "u_tid.h"
+#include "chan.h"
+
+#include "xassert.h"
+#include "xmemcpy.h"
+#include "u_syscall.h"
+
+void
+chan_init(struct chan *c, void *mem, size_t size, tid_t consumer)
+{
+    assert(size > 0 && (size & (size - 1)) == 0);
+    c->wr       = 0;
+    c->rd       = 0;
+    c->waiting  = false;
+    c->mem      = mem;
+    c->size     = size;
+    c->consumer = consumer;
+}
+
+size_t
+chan_used(const struct chan *c)
+{
+    return c->wr - c->rd;
+}
+
+size_t
+chan_free(const struct chan *c)
+{
+    return c->size - (c->wr - c->rd);
+}
+
+size_t
+chan_write(struct chan *c, const void *buf, size_t n)
+{
+    uint32_t wr = c->wr;
+    size_t room, off, first;
+
+    room = c->size - (wr - c->rd);
+    if (n > room)
+        n = room;
+    if (n == 0)
+        return 0;
+
+    /* At most two pieces, either side of the wrap */
+    off   = wr & (c->size - 1);
+    first = c->size - off;
+    if (first > n)
+        first = n;
+    memcpy(c->mem + off, buf, first);
+    memcpy(c->mem, (const char*)buf + first, n - first);
+
+    /* Publish the data, then see if the consumer needs waking */
+    barrier();
+    c->wr = wr + n;
+    barrier();
+    if (c->waiting) {
+        c->waiting = false;
+        Unpark(c->consumer);
+    }
+    return n;
+}
+
+size_t
+chan_read(struct chan *c, void *buf, size_t n)
+{
+    uint32_t rd = c->rd;
+    size_t avail, off, first;
+
+    avail = c->wr - rd;
+    barrier();
+    if (n > avail)
+        n = avail;
+    if (n == 0)
+        return 0;
+
+    off   = rd & (c->size - 1);
+    first = c->size - off;
+    if (first > n)
+        first = n;
+    memcpy(buf, c->mem + off, first);
+    memcpy((char*)buf + first, c->mem, n - first);
+
+    /* Only free the space once it's been copied out */
+    barrier();
+    c->rd = rd + n;
+    return n;
+}
+
+size_t
+chan_read_wait(struct chan *c, void *buf, size_t n)
+{
+    size_t got;
+
+    for (;;) {
+        got = chan_read(c, buf, n);
+        if (got > 0 || n == 0)
+            return got;
+
+        /* Say we're going to sleep, then check again, so that a write
+         * in between either is seen here or leaves an Unpark() token */
+        c->waiting = true;
+        barrier();
+        if (c->wr != c->rd) {
+            c->waiting = false;
+            continue;
+        }
+        Park();
+    }
+}
@@ -0,0 +1,78 @@
+/*******************************************************************************
+    Copyright 2014 Matthew Thiffault
+
+    This file is part of HeatheRTOS.
+
+    HeatheRTOS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    HeatheRTOS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with HeatheRTOS.  If not, see <http://www.gnu.org/licenses/>.
+
+*******************************************************************************/
+
+#ifndef CHAN_H
+#define CHAN_H
+
+#include "xbool.h"
+#include "xint.h"
+#include "xdef.h"
+#include "u_tid.h"
+#include "section.h"
+
+/*
+ * Single producer, single consumer byte channel in shared memory.
+ *
+ * Tasks share an address space, so a stream can go through a ring
+ * buffer instead of a Send() per item. Only the consumer ever blocks:
+ * chan_read_wait() parks it while the ring is empty, and the producer
+ * unparks it when it writes, which costs a system call only while the
+ * consumer is actually waiting. Writes never block; they return how
+ * much fitted.
+ *
+ * The producer and consumer indices are on separate cache lines, and
+ * each side only writes its own; the waiting flag is the exception, as
+ * the producer clears it when it does the Unpark(). There is only one
+ * core, so ordering is enforced with compiler barriers alone.
+ */
+
+struct chan {
+    /* Written by the producer only */
+    volatile uint32_t wr CACHE_ALIGNED; /* free running */
+
+    /* Written by the consumer only */
+    volatile uint32_t rd CACHE_ALIGNED; /* free running */
+    volatile bool     waiting;          /* parked, or about to */
+
+    /* Set up by chan_init() */
+    char   *mem CACHE_ALIGNED;
+    size_t  size; /* a power of two */
+    tid_t   consumer;
+};
+
+/* Set up a channel over size bytes at mem, to be read by the task
+ * consumer. size must be a power of two. */
+void chan_init(struct chan *c, void *mem, size_t size, tid_t consumer);
+
+/* Write up to n bytes. Returns the number written, which is less than
+ * n if the ring fills up. */
+size_t chan_write(struct chan *c, const void *buf, size_t n);
+
+/* Read up to n bytes that are already there, without blocking. */
+size_t chan_read(struct chan *c, void *buf, size_t n);
+
+/* Read up to n bytes, blocking until there is at least one. */
+size_t chan_read_wait(struct chan *c, void *buf, size_t n);
+
+/* Bytes in the ring, and room left */
+size_t chan_used(const struct chan *c);
+size_t chan_free(const struct chan *c);
+
+#endif
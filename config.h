@@ -28,6 +28,37 @@
 #define PRIORITY_MAX         0   /* Smallest priority number */
 #define PRIORITY_MIN        14   /* Lowest priority number a user task can have */
 #define PRIORITY_IDLE       15   /* Priority of the IDLE task */
+#define TASK_ARG_MAX        256  /* Largest argument CreateArg() will copy */
+#define OCMC_STACK_SIZE     2048 /* Size of each CREATE_OCMC_STACK stack */
+
+/* Transactions started by SendAsync() that may be outstanding at once,
+ * across all tasks. At most 254. */
+#define IPC_TXN_MAX         64
+
+/* Reuse the most recently freed task descriptor first, so a respawned
+ * task finds its stack still in cache. TIDs are then recycled faster:
+ * a slot's 8-bit sequence number wraps after 256 respawns. */
+//#define TASK_POOL
+
+/* Most IRQs serviced in one kernel entry before scheduling */
+#define IRQ_DRAIN_MAX       16
+
+/* Messages longer than this are copied a chunk at a time, with pending
+ * IRQs serviced between chunks */
+#define IPC_COPY_CHUNK      1024
+
+/* Record the cycles spent in each kernel entry, per system call and
+ * per IRQ, and print them on exit when kparam.show_wcet is set. Costs
+ * a couple of dozen cycles per entry. See wcet.h. */
+//#define KERN_WCET
+
+/* Kernel mailboxes, and their largest message. Post() copies the
+ * message in the kernel, so this bounds its cost. See mbox.h. */
+#define MBOX_MAX            16
+#define MBOX_MSG_MAX        256
+
+/* Jobs a cyclic executive table can refer to. See cyclic.h. */
+#define CYCLIC_MAX_JOBS     8
 
 /* Select priority queue implementation. */
 #define PQ_RING
@@ -32,6 +32,9 @@ enum {
 };
 #undef DEFMODE
 
+/* PSR bit set when executing Thumb code */
+#define PSR_THUMB 0x20
+
 /* CPU Mode Functions */
 
 /* Get CSPR */
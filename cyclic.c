@@ -0,0 +1,227 @@
+/*******************************************************************************
+    Copyright 2014 Matthew Thiffault
+
+    This file is part of HeatheRTOS.
+
+    HeatheRTOS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    HeatheRTOS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with HeatheRTOS.  If not, see <http://www.gnu.org/licenses/>.
+
+*******************************************************************************/
+
+#include "config.h"
+#include "xbool.h"
+#include "xint.h"
+#include "xdef.h"
+#include "static_assert.h"
+#include "u_tid.h"
+#include "task.h"
+#include "event.h"
+#include "kern.h"
+#include "cyclic.h"
+
+#include "xassert.h"
+#include "section.h"
+#include "timer.h"
+#include "ktimer.h"
+
+static void cyclic_check(const struct cyclic_table *table);
+static uint32_t cyclic_start(struct cyclic *c, int slot);
+static void cyclic_slot_start(struct kern *kern);
+static void cyclic_slot_end(struct kern *kern);
+
+COLD void
+cyclic_init(struct kern *kern, const struct cyclic_table *table)
+{
+    struct cyclic *c = &kern->cyclic;
+    int i;
+
+    for (i = 0; i < CYCLIC_MAX_JOBS; i++) {
+        c->jobs[i].td       = NULL;
+        c->jobs[i].overruns = 0;
+    }
+    c->table   = table;
+    c->cur     = 0;
+    c->in_slot = false;
+    c->running = NULL;
+    if (table == NULL)
+        return;
+
+    cyclic_check(table);
+    c->major       = table->minor_us * table->n_minor * DBG_TMR_TICKS_PER_US;
+    c->frame_start = dbg_tmr_ticks();
+    c->next        = cyclic_start(c, 0);
+}
+
+/* The table is fixed at compile time, so a bad one is a bug */
+static COLD void
+cyclic_check(const struct cyclic_table *table)
+{
+    const struct cyclic_slot *s, *prev = NULL;
+    int i;
+
+    if (table->minor_us == 0 || table->n_minor <= 0 || table->n_slots <= 0)
+        panic("cyclic: empty table");
+    if (table->minor_us > DBG_TMR_MAX_US / table->n_minor)
+        panic("cyclic: major frame too long");
+
+    for (i = 0; i < table->n_slots; i++) {
+        s = &table->slots[i];
+        if (s->job >= CYCLIC_MAX_JOBS || s->frame >= table->n_minor)
+            panic("cyclic: slot %d: bad job or frame", i);
+        if (s->len_us == 0
+            || s->start_us >= table->minor_us
+            || s->len_us > table->minor_us - s->start_us)
+            panic("cyclic: slot %d: outside its minor frame", i);
+        if (prev != NULL
+            && (s->frame < prev->frame
+                || (s->frame == prev->frame
+                    && s->start_us < prev->start_us + prev->len_us)))
+            panic("cyclic: slot %d: out of order or overlapping", i);
+        prev = s;
+    }
+}
+
+/* Start time of a slot in the current major frame */
+static HOT uint32_t
+cyclic_start(struct cyclic *c, int slot)
+{
+    const struct cyclic_slot *s = &c->table->slots[slot];
+    uint32_t us = s->frame * c->table->minor_us + s->start_us;
+    return c->frame_start + us * DBG_TMR_TICKS_PER_US;
+}
+
+HOT void
+cyclic_advance(struct kern *kern, uint32_t now)
+{
+    struct cyclic *c = &kern->cyclic;
+
+    if (c->table == NULL)
+        return;
+
+    while ((int32_t)(now - c->next) >= 0) {
+        if (c->in_slot)
+            cyclic_slot_end(kern);
+        else
+            cyclic_slot_start(kern);
+    }
+}
+
+static HOT void
+cyclic_slot_start(struct kern *kern)
+{
+    struct cyclic *c = &kern->cyclic;
+    const struct cyclic_slot *s = &c->table->slots[c->cur];
+    struct task_desc *td = c->jobs[s->job].td;
+
+    c->in_slot = true;
+    c->running = td;
+    c->next   += s->len_us * DBG_TMR_TICKS_PER_US;
+    if (td != NULL && TASK_STATE(kern, td) == TASK_STATE_CYCLIC_BLOCKED)
+        task_ready(kern, td);
+}
+
+static HOT void
+cyclic_slot_end(struct kern *kern)
+{
+    struct cyclic *c = &kern->cyclic;
+    const struct cyclic_slot *s = &c->table->slots[c->cur];
+    struct task_desc *td = c->running;
+
+    if (td != NULL && TASK_STATE(kern, td) != TASK_STATE_CYCLIC_BLOCKED)
+        c->jobs[s->job].overruns++;
+
+    c->in_slot = false;
+    c->running = NULL;
+    if (++c->cur == c->table->n_slots) {
+        c->cur          = 0;
+        c->frame_start += c->major;
+    }
+    c->next = cyclic_start(c, c->cur);
+}
+
+HOT struct task_desc*
+cyclic_schedule(struct kern *kern)
+{
+    struct task_desc *td = kern->cyclic.running;
+
+    if (td == NULL || TASK_STATE(kern, td) != TASK_STATE_READY)
+        return task_schedule(kern);
+
+    task_unready(kern, td);
+    TASK_SET_STATE(kern, td, TASK_STATE_ACTIVE);
+    return td;
+}
+
+HOT void
+cyclic_wait(struct kern *kern, struct task_desc *active)
+{
+    struct cyclic *c = &kern->cyclic;
+    struct cyclic_job *job;
+    int ix = (int)active->regs->r0;
+    int i;
+
+    if (c->table == NULL || ix < 0 || ix >= CYCLIC_MAX_JOBS) {
+        active->regs->r0 = -1;
+        task_ready(kern, active);
+        return;
+    }
+
+    job = &c->jobs[ix];
+    if (job->td != active) {
+        /* Claim the job, if it's free and we don't have another */
+        for (i = 0; i < CYCLIC_MAX_JOBS; i++) {
+            if (c->jobs[i].td == active)
+                break;
+        }
+        if (job->td != NULL || i < CYCLIC_MAX_JOBS) {
+            active->regs->r0 = -2;
+            task_ready(kern, active);
+            return;
+        }
+        job->td = active;
+    }
+
+    /* Done with this slot, if we're in it; sleep until the next one */
+    active->regs->r0 = job->overruns;
+    job->overruns    = 0;
+    TASK_SET_STATE(kern, active, TASK_STATE_CYCLIC_BLOCKED);
+}
+
+HOT uint32_t
+cyclic_next(struct kern *kern, uint32_t now)
+{
+    int32_t until;
+
+    if (kern->cyclic.table == NULL)
+        return KTIMER_NEVER;
+    until = kern->cyclic.next - now;
+    return until < 1 ? 1 : (uint32_t)until;
+}
+
+void
+cyclic_forget(struct kern *kern, struct task_desc *td)
+{
+    struct cyclic *c = &kern->cyclic;
+    int i;
+
+    if (c->table == NULL)
+        return;
+    for (i = 0; i < CYCLIC_MAX_JOBS; i++) {
+        if (c->jobs[i].td == td) {
+            c->jobs[i].td       = NULL;
+            c->jobs[i].overruns = 0;
+        }
+    }
+    if (c->running == td)
+        c->running = NULL;
+}
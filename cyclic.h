@@ -0,0 +1,97 @@
+/*******************************************************************************
+    Copyright 2014 Matthew Thiffault
+
+    This file is part of HeatheRTOS.
+
+    HeatheRTOS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    HeatheRTOS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with HeatheRTOS.  If not, see <http://www.gnu.org/licenses/>.
+
+*******************************************************************************/
+
+#ifndef CYCLIC_H
+#define CYCLIC_H
+
+#include "xbool.h"
+#include "xint.h"
+#include "config.h"
+
+/*
+ * Cyclic executive. A static table divides a major frame into minor
+ * frames, and reserves slots within them for jobs. Each job is a task
+ * that loops on CyclicWait(job): at the start of each of its slots the
+ * kernel timer brings us into the kernel and the job is dispatched
+ * ahead of the ready queues, whatever its priority. Between slots, and
+ * once the job is done with its slot, the ready queues run as usual.
+ *
+ * A job that hasn't called CyclicWait() again by the end of its slot
+ * has overrun. It loses its reservation, and carries on at its own
+ * priority (and in its next slot) until it does; CyclicWait() then
+ * returns the number of slots it overran.
+ *
+ * The table is given to kern_main() in kparam.cyclic. While there is
+ * one, the kernel runs until Shutdown().
+ */
+
+struct kern;
+struct task_desc;
+
+struct cyclic_slot {
+    uint16_t frame;    /* minor frame within the major frame */
+    uint16_t job;      /* < CYCLIC_MAX_JOBS */
+    uint32_t start_us; /* from the start of the minor frame */
+    uint32_t len_us;
+};
+
+struct cyclic_table {
+    uint32_t                  minor_us;  /* minor frame length */
+    int                       n_minor;   /* minor frames per major frame */
+    int                       n_slots;
+    const struct cyclic_slot *slots;     /* by frame, then start_us */
+};
+
+struct cyclic_job {
+    struct task_desc *td;       /* NULL until its first CyclicWait() */
+    uint32_t          overruns; /* since its last CyclicWait() */
+};
+
+struct cyclic {
+    const struct cyclic_table *table;   /* NULL when off */
+    uint32_t           major;           /* major frame, in ticks */
+    uint32_t           frame_start;     /* of the current major frame */
+    uint32_t           next;            /* next slot start or end */
+    int                cur;             /* current or next slot */
+    bool               in_slot;         /* slot cur has started */
+    struct task_desc  *running;         /* job owning slot cur, if started */
+    struct cyclic_job  jobs[CYCLIC_MAX_JOBS];
+};
+
+/* Start the schedule from now. The table may be NULL. */
+void cyclic_init(struct kern *kern, const struct cyclic_table *table);
+
+/* Start and end the slots whose times have come */
+void cyclic_advance(struct kern *kern, uint32_t now);
+
+/* Pick the next task to run: the job in its slot if it can run,
+ * otherwise as task_schedule() */
+struct task_desc *cyclic_schedule(struct kern *kern);
+
+/* CyclicWait() for the active task */
+void cyclic_wait(struct kern *kern, struct task_desc *active);
+
+/* Ticks until the next slot start or end, or KTIMER_NEVER */
+uint32_t cyclic_next(struct kern *kern, uint32_t now);
+
+/* Release any job held by an exiting task */
+void cyclic_forget(struct kern *kern, struct task_desc *td);
+
+#endif
@@ -26,8 +26,13 @@
 #include "event.h"
 
 #include "intr.h"
+#include "fiq.h"
 #include "array_size.h"
 #include "xassert.h"
+#include "bithack.h"
+#include "timer.h"
+
+static void evt_arm(struct eventab *tab, int irq, bool armed);
 
 /* Initialize the kernel IRQ event system */
 void
@@ -37,56 +42,170 @@ evt_init(struct eventab *tab)
     /* Reset the interrupt controller */
     intr_reset();
     /* Reset the event table */
-    for (i = 0; i < ARRAY_SIZE(tab->events); i++)
-        tab->events[i].tid = -1;
+    for (i = 0; i < ARRAY_SIZE(tab->events); i++) {
+        tab->events[i].tid     = -1;
+        tab->events[i].flags   = 0;
+        tab->events[i].pending = 0;
+        tab->events[i].next    = -1;
+    }
+    /* Reset leaves the threshold disabled */
+    tab->threshold = INTR_NO_THRESHOLD;
+    /* Nothing on the fast path yet */
+    tab->fiq_irq = -1;
+    tab->fiq_tid = -1;
+    tab->fiq_wake = -1;
+    tab->msg_count = 0;
+    for (i = 0; i < ARRAY_SIZE(tab->throttled); i++)
+        tab->throttled[i] = 0;
+    tab->n_throttled = 0;
+    fiq_init();
 }
 
 /* Register a task to handle an IRQ */
 int evt_register(
     struct eventab *tab,
     tid_t tid,
+    int8_t *list,
     int irq,
+    int prio,
+    unsigned int flags,
     int (*cb)(void*, size_t))
 {
     struct event *evt;
+    int8_t *link;
 
     /* Check that the IRQ number makes sense */
     if (irq < 0 || irq >= IRQ_COUNT)
         return IRQ_OOR;
 
-    /* Check that no other task has already registered */
+    /* Event priorities share the task priority scale */
+    if (prio < PRIORITY_MAX || prio > PRIORITY_MIN)
+        return EVT_PRIO_OOR;
+
+    if (flags & ~EVT_FLAGS_ALL)
+        return EVT_BAD_FLAGS;
+
+    /* Check that no other task has already registered, and that the
+       IRQ isn't the fast path's, or reserved to wake its task */
     evt = &tab->events[irq];
-    if (evt->tid >= 0)
+    if (evt->tid >= 0 || irq == tab->fiq_irq)
+        return IRQ_IN_USE;
+    if (irq == tab->fiq_wake && tid != tab->fiq_tid)
         return IRQ_IN_USE;
 
     /* Set up the event */
-    evt->tid = tid;
-    evt->cb  = cb;
+    evt->tid     = tid;
+    evt->cb      = cb;
+    evt->ptr     = NULL;
+    evt->size    = 0;
+    evt->flags   = flags;
+    evt->pending = 0;
+    evt->next    = -1;
+    evt->rc      = 0;
+    evt->limit   = 0;
+    evt->window  = 0;
+    evt->total   = 0;
+    evt->throttled = 0;
+
+    /* Append it to the task's list */
+    for (link = list; *link >= 0; link = &tab->events[(int)*link].next) { }
+    *link = irq;
 
     /* Set priority and ensure that it will be an IRQ,
        not a FIQ. */
-    intr_config(irq, 1, false);
+    intr_config(irq, prio, false);
+
+    if (flags & EVT_MSG)
+        tab->msg_count++;
+
+    /* Latched events start counting right away */
+    if (flags & EVT_LATCHED)
+        evt_arm(tab, irq, true);
     return 0;
 }
 
-/* Un-register a task with respect to an IRQ */
+/* Give a task the FIQ fast path for an IRQ */
 int
-evt_unregister(struct eventab *tab, int irq)
+evt_register_fiq(
+    struct eventab *tab,
+    tid_t tid,
+    int irq,
+    struct fiq_chan *chan)
 {
-    struct event *evt;
+    int wake;
 
-    evt = &tab->events[irq];
-    if (evt->tid < 0)
-        return EVT_NOT_REG;
+    if (irq < 0 || irq >= IRQ_COUNT)
+        return IRQ_OOR;
 
-    /* Disable the interrupt */
-    intr_enable(irq, false);
+    if (tab->events[irq].tid >= 0)
+        return IRQ_IN_USE;
+
+    if (tab->fiq_irq >= 0)
+        return FIQ_IN_USE;
+
+    /* The FIQ handler writes through the channel, and pends the wake
+       IRQ by poking the INTC directly */
+    if (chan == NULL)
+        return FIQ_BAD_CHAN;
+    wake = chan->wake_irq;
+    if (wake >= 0) {
+        if (wake >= IRQ_COUNT || wake == irq)
+            return FIQ_BAD_CHAN;
+        if (tab->events[wake].tid >= 0 && tab->events[wake].tid != tid)
+            return IRQ_IN_USE;
+    } else if (wake != -1) {
+        return FIQ_BAD_CHAN;
+    }
+
+    tab->fiq_irq  = irq;
+    tab->fiq_tid  = tid;
+    tab->fiq_wake = wake;
+    fiq_attach(irq, chan);
+    return 0;
+}
+
+/* Take the FIQ fast path back */
+int
+evt_unregister_fiq(struct eventab *tab)
+{
+    if (tab->fiq_irq < 0)
+        return EVT_NOT_REG;
 
-    /* Free up the IRQ */
-    evt->tid = -1;
+    fiq_detach(tab->fiq_irq);
+    tab->fiq_irq  = -1;
+    tab->fiq_tid  = -1;
+    tab->fiq_wake = -1;
     return 0;
 }
 
+/* Un-register all of a task's IRQs */
+void
+evt_unregister_all(struct eventab *tab, int8_t *list)
+{
+    int irq = *list;
+    while (irq >= 0) {
+        struct event *evt = &tab->events[irq];
+
+        /* Disable the interrupt */
+        intr_enable(irq, false);
+        if (evt->flags & EVT_THROTTLED) {
+            tab->throttled[irq / 32] &= ~(1u << (irq % 32));
+            tab->n_throttled--;
+        }
+
+        if (evt->flags & EVT_MSG)
+            tab->msg_count--;
+
+        /* Free up the IRQ */
+        evt->tid     = -1;
+        evt->flags   = 0;
+        evt->pending = 0;
+        irq          = evt->next;
+        evt->next    = -1;
+    }
+    *list = -1;
+}
+
 /* What is the current highest priority event
    to handle? */
 int
@@ -98,28 +217,252 @@ evt_cur(void)
     return irq;
 }
 
-/* Enable (unmask) a particular interrupt, providing the optional
-   arguments to the handler callback */
+/* Is there another event to handle in this kernel entry? */
+int
+evt_next(void)
+{
+    return intr_next();
+}
+
+/* Is any event on the list ready to return right away? */
+bool
+evt_poll(
+    struct eventab *tab,
+    int8_t *list,
+    void *ptr,
+    size_t size,
+    int *irq_out,
+    int *rc_out)
+{
+    int irq;
+    for (irq = *list; irq >= 0; irq = tab->events[irq].next) {
+        struct event *evt = &tab->events[irq];
+        if (evt->flags & EVT_MSG)
+            continue; /* delivered through Receive() */
+        evt->ptr  = ptr;
+        evt->size = size;
+        if (evt->flags & EVT_COUNT) {
+            /* Already accounted for one by one as they were latched */
+            if (evt->pending == 0)
+                continue;
+            *rc_out = evt->pending;
+            evt->pending = 0;
+        } else {
+            if (!intr_asserted(irq))
+                continue;
+            *rc_out = evt->cb(ptr, size);
+            if (*rc_out == -1)
+                continue; /* callback says to ignore this interrupt */
+            /* Caught here instead of by the IRQ handler: count it the
+               same way, or a storm seen only by polling goes unchecked */
+            evt_account(tab, irq);
+        }
+        *irq_out = irq;
+        evt_served(tab, list, irq);
+        return true;
+    }
+    return false;
+}
+
+/* Is an interrupt message waiting for the task? */
+bool
+evt_take_msg(
+    struct eventab *tab,
+    int8_t *list,
+    int *irq_out,
+    struct evt_msg *msg)
+{
+    int irq;
+    for (irq = *list; irq >= 0; irq = tab->events[irq].next) {
+        struct event *evt = &tab->events[irq];
+        if (!(evt->flags & EVT_MSG) || evt->pending == 0)
+            continue;
+        msg->rc      = evt->rc;
+        msg->count   = evt->pending;
+        evt->pending = 0;
+        *irq_out     = irq;
+        evt_served(tab, list, irq);
+        return true;
+    }
+    return false;
+}
+
+/* Enable (unmask) a task's interrupts, providing the optional
+   arguments to the handler callbacks */
 void
-evt_enable(struct eventab *tab, int irq, void *cbptr, size_t cbsize)
+evt_enable(struct eventab *tab, int8_t list, void *cbptr, size_t cbsize)
+{
+    int irq;
+    for (irq = list; irq >= 0; irq = tab->events[irq].next) {
+        struct event *evt = &tab->events[irq];
+        if (evt->flags & EVT_MSG)
+            continue; /* always enabled, always NULL/0 */
+        evt->ptr  = cbptr;
+        evt->size = cbsize;
+        evt_arm(tab, irq, true);
+    }
+}
+
+/* Disable (mask) a task's interrupts, except latched ones */
+void
+evt_disable(struct eventab *tab, int8_t list)
+{
+    int irq;
+    for (irq = list; irq >= 0; irq = tab->events[irq].next) {
+        if (!(tab->events[irq].flags & EVT_LATCHED))
+            evt_arm(tab, irq, false);
+    }
+}
+
+/* Move a just-delivered event to the back of its task's list */
+void
+evt_served(struct eventab *tab, int8_t *list, int irq)
+{
+    int8_t *link;
+    struct event *evt = &tab->events[irq];
+    if (evt->next < 0)
+        return; /* already last */
+
+    /* Unlink it... */
+    for (link = list; *link != irq; link = &tab->events[(int)*link].next)
+        assert(*link >= 0);
+    *link = evt->next;
+
+    /* ...and put it on the end */
+    while (*link >= 0)
+        link = &tab->events[(int)*link].next;
+    *link     = irq;
+    evt->next = -1;
+}
+
+/* Record whether an event's IRQ should be enabled, and enable it
+   unless it's being throttled */
+static void
+evt_arm(struct eventab *tab, int irq, bool armed)
+{
+    struct event *evt = &tab->events[irq];
+    if (armed)
+        evt->flags |= EVT_ARMED;
+    else
+        evt->flags &= ~EVT_ARMED;
+    intr_enable(irq, armed && !(evt->flags & EVT_THROTTLED));
+}
+
+/* Set an event's rate limit */
+int
+evt_limit(
+    struct eventab *tab,
+    tid_t tid,
+    int irq,
+    unsigned int limit,
+    uint32_t window)
 {
     struct event *evt;
+    if (irq < 0 || irq >= IRQ_COUNT)
+        return IRQ_OOR;
 
     evt = &tab->events[irq];
-    evt->ptr  = cbptr;
-    evt->size = cbsize;
+    if (evt->tid != tid)
+        return EVT_NOT_REG;
 
-    intr_enable(irq, true);
+    if (window > DBG_TMR_MAX_US)
+        window = DBG_TMR_MAX_US;
+    evt->limit        = limit > 0xffff ? 0xffff : limit;
+    evt->window       = window * DBG_TMR_TICKS_PER_US;
+    evt->in_window    = 0;
+    evt->window_start = dbg_tmr_ticks();
+    return 0;
 }
 
-/* Disable (mask) a particular interrupt */
+/* Count an occurrence, and throttle the event if it's storming */
 void
-evt_disable(struct eventab *tab, int irq)
+evt_account(struct eventab *tab, int irq)
 {
-    (void)tab;
+    struct event *evt = &tab->events[irq];
+    uint32_t now;
+
+    evt->total++;
+    if (evt->limit == 0)
+        return;
+
+    now = dbg_tmr_ticks();
+    if (now - evt->window_start >= evt->window) {
+        evt->window_start = now;
+        evt->in_window    = 0;
+    }
+
+    if (++evt->in_window < evt->limit)
+        return;
+
+    /* Limit reached: mask until the window is over */
+    evt->throttled++;
+    evt->flags |= EVT_THROTTLED;
+    tab->throttled[irq / 32] |= 1u << (irq % 32);
+    tab->n_throttled++;
     intr_enable(irq, false);
 }
 
+/* Let throttled events back in once their windows are over */
+void
+evt_unthrottle(struct eventab *tab)
+{
+    unsigned int i;
+    uint32_t now;
+
+    if (tab->n_throttled == 0)
+        return;
+
+    now = dbg_tmr_ticks();
+    for (i = 0; i < ARRAY_SIZE(tab->throttled); i++) {
+        uint32_t bits = tab->throttled[i];
+        while (bits != 0) {
+            int irq = 32 * i + ctz32(bits);
+            struct event *evt = &tab->events[irq];
+            bits &= bits - 1;
+            if (now - evt->window_start < evt->window)
+                continue;
+
+            evt->flags &= ~EVT_THROTTLED;
+            evt->window_start = now;
+            evt->in_window    = 0;
+            tab->throttled[i] &= ~(1u << (irq % 32));
+            tab->n_throttled--;
+            if (evt->flags & EVT_ARMED)
+                intr_enable(irq, true);
+        }
+    }
+}
+
+/* Read out an event's counters */
+int
+evt_stats(struct eventab *tab, int irq, struct evt_stats *out)
+{
+    struct event *evt;
+    if (irq < 0 || irq >= IRQ_COUNT)
+        return IRQ_OOR;
+
+    evt = &tab->events[irq];
+    if (evt->tid < 0)
+        return EVT_NOT_REG;
+
+    out->total     = evt->total;
+    out->throttled = evt->throttled;
+    out->pending   = evt->pending;
+    return 0;
+}
+
+/* Only let through events at least as important as the running task */
+void
+evt_threshold(struct eventab *tab, int task_prio)
+{
+    unsigned int threshold = task_prio + 1;
+    if (threshold == tab->threshold)
+        return;
+
+    tab->threshold = threshold;
+    intr_threshold(threshold);
+}
+
 /* Acknowledge the IRQ so that more can happen */
 void
 evt_acknowledge(void)
@@ -131,5 +474,6 @@ evt_acknowledge(void)
 void
 evt_cleanup(void)
 {
+    fiq_cleanup();
     intr_reset();
 }
@@ -26,6 +26,7 @@
 #include "xdef.h"
 #include "u_tid.h"
 #include "config.h"
+#include "event_flags.h"
 
 #include "intr.h"
 
@@ -34,57 +35,188 @@ enum {
     IRQ_OOR     = -1,
     IRQ_IN_USE  = -2,
     EVT_NOT_REG = -3,
-    EVT_DBL_REG = -4
+    EVT_DBL_REG = -4,
+    EVT_PRIO_OOR = -5,
+    FIQ_IN_USE  = -6,
+    EVT_BAD_FLAGS = -7,
+    FIQ_BAD_CHAN = -8
 };
 
+struct fiq_chan;
+
 /* An event slot. Each registered event belongs to a particular task.
  * It is associated with a particular IRQ.
- * Events are triggered based on IRQs, and prioritized using the VIC.
- * Events have priority in order of their event ID. */
+ * Events are triggered based on IRQs, and prioritized using the INTC.
+ * Each event is given a priority on the same scale as task priorities
+ * when it is registered.
+ * With EVT_COUNT, occurrences that arrive while the owner isn't blocked
+ * are latched in pending instead of being lost.
+ * A task may own several events. They form a list threaded through
+ * next, whose head is kept in the task descriptor.
+ * An event may be rate limited: once limit occurrences have been seen
+ * within window microseconds, its IRQ is masked until the window is
+ * over. */
 struct event {
-    tid_t  tid;                 /* owning task */
-    int  (*cb)(void*, size_t);  /* callback supplied by owning task */
-    void  *ptr;                 /* AwaitEvent() arguments */
-    size_t size;                /* (these are passed to cb) */
+    tid_t    tid;               /* owning task */
+    int    (*cb)(void*, size_t);/* callback supplied by owning task */
+    void    *ptr;               /* AwaitEvent() arguments */
+    size_t   size;              /* (these are passed to cb) */
+    uint16_t flags;             /* EVT_* flags from registration */
+    uint16_t pending;           /* latched: undelivered occurrences */
+    int8_t   next;              /* next event of the same task, or -1 */
+    int      rc;                /* EVT_MSG: latest callback result */
+
+    /* Storm protection */
+    uint16_t limit;             /* occurrences per window, 0 = no limit */
+    uint16_t in_window;         /* occurrences in the current window */
+    uint32_t window;            /* window length (ticks) */
+    uint32_t window_start;      /* dbg_tmr_ticks() at start of window */
+
+    /* Monitoring */
+    uint32_t total;             /* occurrences accepted by callback */
+    uint32_t throttled;         /* times masked by the rate limit */
 };
 
+/* Most occurrences an event will latch */
+#define EVT_PENDING_MAX 0xffff
+
+/* Kernel-internal event state, kept in the high bits of flags */
+#define EVT_ARMED       0x4000  /* IRQ should be enabled */
+#define EVT_THROTTLED   0x8000  /* IRQ masked by the rate limit */
+
 /* Event table. Accounts for all event registration data. */
 struct eventab {
     struct event events[IRQ_COUNT];
+    unsigned int threshold; /* current INTC priority threshold */
+    int          fiq_irq;   /* IRQ routed to the FIQ fast path, or -1 */
+    tid_t        fiq_tid;   /* task owning the FIQ channel */
+    int          fiq_wake;  /* the channel's wake IRQ, or -1 */
+    int          msg_count; /* registered EVT_MSG events */
+    uint32_t     throttled[IRQ_COUNT / 32]; /* throttled IRQ bitmap */
+    int          n_throttled;
 };
 
 /* Initialize the event table. This resets the interrupt controller. */
 void evt_init(struct eventab *tab);
 
-/* Register an event to a given task with a given callback function.
+/* Register an event to a given task with a given callback function,
+ * appending it to the task's event list.
+ * The priority is on the task priority scale (0 is most important).
  * Returns 0 for success, or:
- *  - EVT_OOR if the event ID is out of range
- *  - EVT_IN_USE if the event ID is already in use
  *  - IRQ_OOR if the IRQ is out of range
  *  - IRQ_IN_USE if the IRQ is already in use
+ *  - EVT_PRIO_OOR if the priority is out of range
+ *  - EVT_BAD_FLAGS if unknown flags were given
+ * Counting events (EVT_COUNT) are enabled immediately.
  */
 int evt_register(
     struct eventab *tab,
     tid_t tid,
+    int8_t *list,
     int irq,
+    int prio,
+    unsigned int flags,
     int (*cb)(void*, size_t));
 
-/* Unregister a registered event by ID. Returns 0 for success, or
- * EVT_NOT_REG if that event is not registered. */
-int  evt_unregister(struct eventab *tab, int event);
+/* Route an IRQ to the FIQ fast path on behalf of a task. Samples are
+ * captured into chan without entering the kernel. Only one IRQ at a
+ * time can use the fast path. Returns 0 for success, or:
+ *  - IRQ_OOR if the IRQ is out of range
+ *  - IRQ_IN_USE if the IRQ is already registered as an event, or the
+ *    channel's wake IRQ is registered by another task
+ *  - FIQ_IN_USE if the fast path is already taken
+ *  - FIQ_BAD_CHAN if chan is NULL, or its wake IRQ is out of range or
+ *    the FIQ line itself
+ * The wake IRQ is then reserved for the channel's task.
+ */
+int evt_register_fiq(
+    struct eventab *tab,
+    tid_t tid,
+    int irq,
+    struct fiq_chan *chan);
+
+/* Release the FIQ fast path. Returns 0, or EVT_NOT_REG if unused. */
+int evt_unregister_fiq(struct eventab *tab);
+
+/* Unregister every event on a task's list, leaving it empty. */
+void evt_unregister_all(struct eventab *tab, int8_t *list);
 
 /* Get the number of the next IRQ to handle. */
 int  evt_cur(void);
 
-/* Enable the IRQ corresponding to the given event.
+/* After an IRQ has been handled and acknowledged, get the next one
+ * still pending, or -1 if there is none. */
+int  evt_next(void);
+
+/* Look for an event on the list that can be returned from AwaitEvent()
+ * without blocking: a counting event with occurrences latched, or an
+ * IRQ that is already asserted and accepted by its callback. The list
+ * is scanned from the head, and the event found is moved to the tail,
+ * so that several busy IRQs are serviced round-robin.
+ * The AwaitEvent() parameters are saved for the callbacks.
+ * Returns true and fills in irq_out and rc_out if an event was found.
+ * EVT_MSG events are left alone. */
+bool evt_poll(
+    struct eventab *tab,
+    int8_t *list,
+    void *ptr,
+    size_t size,
+    int *irq_out,
+    int *rc_out);
+
+/* Take the first EVT_MSG event on the list with occurrences latched,
+ * moving it to the tail as evt_poll() does. Returns true and fills in
+ * irq_out and msg if there was one. */
+bool evt_take_msg(
+    struct eventab *tab,
+    int8_t *list,
+    int *irq_out,
+    struct evt_msg *msg);
+
+/* Enable the IRQs of all events on a task's list.
  * This accepts parameters for AwaitEvent, which need to be saved
- * for the callback. */
-void evt_enable(struct eventab *tab, int event, void*, size_t);
+ * for the callbacks. */
+void evt_enable(struct eventab *tab, int8_t list, void*, size_t);
+
+/* Disable the IRQs of all events on a task's list.
+ * IRQs are kept disabled unless their owning task is inside AwaitEvent(),
+ * or the event is latched (EVT_COUNT, EVT_MSG). This way, it's impossible to swallow an IRQ
+ * while no task is waiting. */
+void evt_disable(struct eventab *tab, int8_t list);
+
+/* Note that irq has just been delivered: move it to the tail of the
+ * task's list, behind any others that may be waiting. */
+void evt_served(struct eventab *tab, int8_t *list, int irq);
+
+/* Set the rate limit of an event owned by tid: at most limit
+ * occurrences per window microseconds (at most DBG_TMR_MAX_US; longer
+ * windows are cut down to that). A limit of 1 makes window a
+ * coalescing interval; a limit of 0 removes the limit. Returns 0, or:
+ *  - IRQ_OOR if the IRQ is out of range
+ *  - EVT_NOT_REG if tid doesn't own the event
+ */
+int evt_limit(
+    struct eventab *tab,
+    tid_t tid,
+    int irq,
+    unsigned int limit,
+    uint32_t window);
+
+/* Count an occurrence accepted by the event's callback, masking the
+ * IRQ if it has exceeded its rate limit. */
+void evt_account(struct eventab *tab, int irq);
+
+/* Unmask throttled IRQs whose windows are over. Cheap when nothing
+ * is throttled. Called before every switch into a user task. */
+void evt_unthrottle(struct eventab *tab);
+
+/* Read an event's counters. Returns 0, IRQ_OOR or EVT_NOT_REG. */
+int evt_stats(struct eventab *tab, int irq, struct evt_stats *out);
 
-/* Disable the IRQ corresponding to the given event.
- * IRQs are kept disabled unless their owning task is inside AwaitEvent().
- * This way, it's impossible to swallow an IRQ while no task is waiting. */
-void evt_disable(struct eventab *tab, int event);
+/* Mask all events less important than a task running at the given
+ * priority. Events of equal or higher priority can still interrupt it.
+ * Called before every switch into a user task. */
+void evt_threshold(struct eventab *tab, int task_prio);
 
 /* Do any work needed for the interrupt controller before resuming a user
  task. This may be clearing the particular interrupt, etc. */
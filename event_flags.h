@@ -0,0 +1,59 @@
+/*******************************************************************************
+    Copyright 2014 Matthew Thiffault
+
+    This file is part of HeatheRTOS.
+
+    HeatheRTOS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    HeatheRTOS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with HeatheRTOS.  If not, see <http://www.gnu.org/licenses/>.
+
+*******************************************************************************/
+
+#ifndef EVENT_FLAGS_H
+#define EVENT_FLAGS_H
+
+/* Flags accepted by RegisterEvent(). Shared by the kernel and tasks. */
+
+/* Latched/counting mode. The IRQ stays enabled from registration on,
+ * and every occurrence accepted by the callback is counted, even while
+ * the owning task is busy elsewhere. AwaitEvent() returns the number
+ * of occurrences since it last returned, immediately if that is
+ * non-zero. The callback gets the buffer passed to the most recent
+ * AwaitEvent() (NULL/0 before the first one). */
+#define EVT_COUNT   0x1
+
+/* Message mode. Instead of AwaitEvent(), the owning task receives the
+ * event through Receive(), from the pseudo-TID EVT_TID(irq), with a
+ * struct evt_msg as the message. The IRQ stays enabled and occurrences
+ * are counted while the task is busy, as with EVT_COUNT. The callback
+ * is passed NULL/0. No Reply() is needed. */
+#define EVT_MSG     0x2
+
+#define EVT_FLAGS_ALL   (EVT_COUNT | EVT_MSG)
+
+/* Flags for which the IRQ stays enabled between deliveries */
+#define EVT_LATCHED     (EVT_COUNT | EVT_MSG)
+
+/* Counters for an event, returned by EventStats() */
+struct evt_stats {
+    unsigned int total;     /* occurrences accepted by the callback */
+    unsigned int throttled; /* times masked for exceeding the rate limit */
+    unsigned int pending;   /* latched, not yet delivered */
+};
+
+/* Message delivered for EVT_MSG events */
+struct evt_msg {
+    int rc;     /* result of the most recent callback */
+    int count;  /* occurrences since the last message */
+};
+
+#endif
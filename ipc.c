@@ -31,6 +31,7 @@
 
 #include "xassert.h"
 #include "xmemcpy.h"
+#include "section.h"
 
 #include "xarg.h"
 #include "bwio.h"
@@ -50,11 +51,36 @@
 #define RPLY_ARG_RPLY(td)    ((const char*)(td)->regs->r1)
 #define RPLY_ARG_RPLYLEN(td) ((int)(td)->regs->r2)
 
-/* Forward declaration of rendezvous function */
+/* Forward declaration of helper functions */
 static void rendezvous(struct kern*, struct task_desc*, struct task_desc*);
+static void ipc_copy_start(
+    struct kern *kern,
+    struct task_desc *owner,
+    struct task_desc *peer,
+    int op,
+    struct task_desc *sender,
+    struct task_desc *receiver,
+    char *dst,
+    const char *src,
+    int len);
+static void ipc_copy_done(struct kern *kern, struct ipc_copy *copy);
+static int  ipc_txn_handle(struct kern *kern, struct ipc_txn *txn);
+static struct ipc_txn *ipc_txn_get(struct kern *kern, int handle);
+static void ipc_txn_free(struct kern *kern, struct ipc_txn *txn);
+static void ipc_txn_deliver(
+    struct kern *kern,
+    struct ipc_txn *txn,
+    struct task_desc *receiver);
+static int  ipc_txn_reply(struct kern *kern, tid_t tid, const char *buf, int len);
+static void ipc_txn_complete(struct kern *kern, struct ipc_txn *txn, int result);
+static void ipc_txn_collect(
+    struct kern *kern,
+    struct task_desc *client,
+    struct ipc_txn *txn,
+    int i);
 
 /* Called to start a send when requested by a user task */
-void
+HOT void
 ipc_send_start(struct kern *kern, struct task_desc *active)
 {
     struct task_desc *srv;
@@ -67,52 +93,140 @@ ipc_send_start(struct kern *kern, struct task_desc *active)
         return;
     }
 
-    if (TASK_STATE(srv) == TASK_STATE_SEND_BLOCKED) {
+    if (TASK_STATE(kern, srv) == TASK_STATE_SEND_BLOCKED) {
         rendezvous(kern, active, srv);
     } else {
-        TASK_SET_STATE(active, TASK_STATE_RECEIVE_BLOCKED);
+        TASK_SET_STATE(kern, active, TASK_STATE_RECEIVE_BLOCKED);
         task_enqueue(kern, active, &srv->senders);
     }
 }
 
 /* Called to attempt to receive when requested by a user task */
-void
+HOT void
 ipc_receive_start(struct kern *kern, struct task_desc *active)
 {
-    struct task_desc *sender = task_dequeue(kern, &active->senders);
+    struct task_desc *sender;
+
+    /* Interrupt messages go ahead of ordinary senders */
+    if (active->evt_pending > 0) {
+        struct evt_msg msg;
+        int irq;
+        if (evt_take_msg(&kern->eventab, &active->irq, &irq, &msg)) {
+            active->evt_pending--;
+            ipc_event_deliver(kern, active, irq, &msg);
+            return;
+        }
+    }
+
+    sender = task_dequeue(kern, &active->senders);
     if (sender != NULL) {
         rendezvous(kern, sender, active);
+    } else if (active->txn_head != TXN_IX_NULL) {
+        /* Then transactions, which go behind blocked senders */
+        struct ipc_txn *txn = &kern->txns[active->txn_head];
+        active->txn_head = txn->next_ix;
+        if (active->txn_head == TXN_IX_NULL)
+            active->txn_tail = TXN_IX_NULL;
+        ipc_txn_deliver(kern, txn, active);
     } else {
-        TASK_SET_STATE(active, TASK_STATE_SEND_BLOCKED);
+        TASK_SET_STATE(kern, active, TASK_STATE_SEND_BLOCKED);
     }
 }
 
-/* Called to initiate a reply when requested by a user task */
+/* Called to hand an interrupt message to a receiving task */
 void
+ipc_event_deliver(
+    struct kern *kern,
+    struct task_desc *receiver,
+    int irq,
+    const struct evt_msg *msg)
+{
+    int recv_msglen, copy_msglen;
+
+    recv_msglen = RECV_ARG_MSGLEN(receiver);
+    copy_msglen = (int)sizeof (*msg);
+    if (copy_msglen > recv_msglen)
+        copy_msglen = recv_msglen;
+
+    /* Return from Receive() as if EVT_TID(irq) had sent it */
+    memcpy(RECV_ARG_MSG(receiver), msg, copy_msglen);
+    *RECV_ARG_PTID(receiver) = EVT_TID(irq);
+    receiver->regs->r0 = sizeof (*msg);
+    task_ready(kern, receiver);
+}
+
+/* Called to initiate a reply when requested by a user task */
+HOT void
 ipc_reply_start(struct kern *kern, struct task_desc *active)
+{
+    active->regs->r0 = ipc_reply(
+        kern,
+        RPLY_ARG_TID(active),
+        RPLY_ARG_RPLY(active),
+        RPLY_ARG_RPLYLEN(active),
+        active);
+    if (!IPC_COPY_PENDING(kern, active))
+        task_ready(kern, active);
+}
+
+/* Called to reply to several tasks when requested by a user task */
+void
+ipc_reply_multi_start(struct kern *kern, struct task_desc *active)
+{
+    const tid_t *tids = (const tid_t*)active->regs->r0;
+    int          n    = (int)active->regs->r1;
+    const char  *buf  = (const char*)active->regs->r2;
+    int          len  = (int)active->regs->r3;
+    int i, replied = 0;
+
+    /* Each reply is copied whole, so keep them short (see Reply) */
+    if (len > IPC_COPY_CHUNK) {
+        active->regs->r0 = -1;
+        task_ready(kern, active);
+        return;
+    }
+
+    /* Each task goes to the back of its own priority's ready queue, so
+       the scheduler picks them up in priority order, and in list order
+       within a priority. */
+    for (i = 0; i < n; i++) {
+        int rc = ipc_reply(kern, tids[i], buf, len, NULL);
+        if (rc == 0 || rc == -4) /* -4: delivered, but truncated */
+            replied++;
+    }
+
+    active->regs->r0 = replied;
+    task_ready(kern, active);
+}
+
+/* Reply to a reply-blocked task */
+HOT int
+ipc_reply(
+    struct kern *kern,
+    tid_t tid,
+    const char *rply_buf,
+    int rply_buflen,
+    struct task_desc *replier)
 {
     struct task_desc *sender;
-    const char *rply_buf;
     char *send_buf;
-    int rply_buflen, send_buflen, copy_buflen;
+    int send_buflen, copy_buflen;
     int rc;
 
-    rc = get_task(kern, RPLY_ARG_TID(active), &sender);
+    if (IS_TXN_TID(tid))
+        return ipc_txn_reply(kern, tid, rply_buf, rply_buflen);
+
+    rc = get_task(kern, tid, &sender);
     if (rc == GET_TASK_SUCCESS) {
-        if (TASK_STATE(sender) != TASK_STATE_REPLY_BLOCKED)
+        if (TASK_STATE(kern, sender) != TASK_STATE_REPLY_BLOCKED)
             rc = -3;
     }
 
-    if (rc != GET_TASK_SUCCESS) {
-        active->regs->r0 = rc;
-        task_ready(kern, active);
-        return;
-    }
+    if (rc != GET_TASK_SUCCESS)
+        return rc;
 
     rc          = 0;
-    rply_buf    = RPLY_ARG_RPLY(active);
     send_buf    = SEND_ARG_RPLY(sender);
-    rply_buflen = RPLY_ARG_RPLYLEN(active);
     send_buflen = SEND_ARG_RPLYLEN(sender);
 
     copy_buflen = rply_buflen;
@@ -121,20 +235,117 @@ ipc_reply_start(struct kern *kern, struct task_desc *active)
         rc = -4;
     }
 
-    /* Copy message */
-    memcpy(send_buf, rply_buf, copy_buflen);
-
     /* Return from Send */
     sender->regs->r0 = rply_buflen;
+
+    /* Copy message */
+    if (replier != NULL && copy_buflen > IPC_COPY_CHUNK) {
+        ipc_copy_start(kern, replier, sender, IPC_COPY_REPLY,
+            sender, replier, send_buf, rply_buf, copy_buflen);
+        return rc;
+    }
+
+    memcpy(send_buf, rply_buf, copy_buflen);
     task_ready(kern, sender);
+    return rc;
+}
 
-    /* Return from Reply */
-    active->regs->r0 = rc;
-    task_ready(kern, active);
+/* Take a task out of the send queue it's waiting on */
+void
+ipc_cancel(struct kern *kern, struct task_desc *td)
+{
+    struct task_desc *srv;
+    int rc;
+    bool found;
+
+    if (TASK_STATE(kern, td) != TASK_STATE_RECEIVE_BLOCKED)
+        return;
+
+    rc = get_task(kern, SEND_ARG_TID(td), &srv);
+    assertv(rc, rc == GET_TASK_SUCCESS);
+    found = task_unlink(kern, td, &srv->senders);
+    assertv(found, found);
+}
+
+/* Fail all senders to a task */
+void
+ipc_abort(struct kern *kern, struct task_desc *td)
+{
+    struct task_desc *sender;
+    tid_t tid = TASK_TID(kern, td);
+    int i;
+
+    while ((sender = task_dequeue(kern, &td->senders)) != NULL) {
+        sender->regs->r0 = GET_TASK_NO_SUCH_TASK;
+        task_ready(kern, sender);
+    }
+
+    /* Nothing links a reply-blocked sender to its receiver */
+    for (i = 0; i < MAX_TASKS; i++) {
+        sender = &kern->tasks[i];
+        if (TASK_STATE(kern, sender) == TASK_STATE_REPLY_BLOCKED
+            && SEND_ARG_TID(sender) == tid) {
+            sender->regs->r0 = GET_TASK_NO_SUCH_TASK;
+            task_ready(kern, sender);
+        }
+    }
+
+    /* Transactions, whether received yet or not */
+    td->txn_head = TXN_IX_NULL;
+    td->txn_tail = TXN_IX_NULL;
+    for (i = 0; i < IPC_TXN_MAX; i++) {
+        struct ipc_txn *txn = &kern->txns[i];
+        if (txn->state != TXN_QUEUED && txn->state != TXN_RECEIVED)
+            continue;
+        if (txn->server_ix != TASK_PTR2IX(kern, td))
+            continue;
+        if (txn->client_ix == TASK_IX_NULL)
+            ipc_txn_free(kern, txn);
+        else
+            ipc_txn_complete(kern, txn, GET_TASK_NO_SUCH_TASK);
+    }
+}
+
+/* Drop a departing client's transactions */
+void
+ipc_txn_drop(struct kern *kern, struct task_desc *td)
+{
+    int i, j, prev, ix = TASK_PTR2IX(kern, td);
+
+    for (i = 0; i < IPC_TXN_MAX; i++) {
+        struct ipc_txn *txn = &kern->txns[i];
+        struct task_desc *srv;
+
+        if (txn->state == TXN_FREE || txn->client_ix != ix)
+            continue;
+
+        switch (txn->state) {
+        case TXN_QUEUED:
+            /* Unlink it from its server's queue */
+            srv  = TASK_IX2PTR(kern, txn->server_ix);
+            prev = TXN_IX_NULL;
+            for (j = srv->txn_head; j != i; j = kern->txns[j].next_ix)
+                prev = j;
+            if (prev == TXN_IX_NULL)
+                srv->txn_head = txn->next_ix;
+            else
+                kern->txns[prev].next_ix = txn->next_ix;
+            if (srv->txn_tail == i)
+                srv->txn_tail = prev;
+            ipc_txn_free(kern, txn);
+            break;
+        case TXN_RECEIVED:
+            txn->client_ix = TASK_IX_NULL;
+            break;
+        default:
+            ipc_txn_free(kern, txn);
+            break;
+        }
+    }
 }
 
 /* Called when a receiver and a sender are matched */
-static void
+static HOT void
 rendezvous(
     struct kern *kern,
     struct task_desc *sender,
@@ -151,11 +362,333 @@ rendezvous(
     copy_msglen = (recv_msglen < send_msglen) ? recv_msglen : send_msglen;
 
     /* Prepare for returning from Receive() */
-    memcpy(recv_msg, send_msg, copy_msglen);
     *RECV_ARG_PTID(receiver) = TASK_TID(kern, sender);
     receiver->regs->r0 = send_msglen;
 
+    /* Long messages are copied on behalf of whichever task made this
+       system call, at its priority */
+    if (copy_msglen > IPC_COPY_CHUNK) {
+        if (TASK_STATE(kern, sender) == TASK_STATE_ACTIVE) {
+            ipc_copy_start(kern, sender, receiver, IPC_COPY_MSG,
+                sender, receiver, recv_msg, send_msg, copy_msglen);
+        } else {
+            ipc_copy_start(kern, receiver, sender, IPC_COPY_MSG,
+                sender, receiver, recv_msg, send_msg, copy_msglen);
+        }
+        return;
+    }
+
+    memcpy(recv_msg, send_msg, copy_msglen);
+
     /* At this point, sender is reply blocked, and receiver can continue */
-    TASK_SET_STATE(sender, TASK_STATE_REPLY_BLOCKED);
+    TASK_SET_STATE(kern, sender, TASK_STATE_REPLY_BLOCKED);
+    task_ready(kern, receiver);
+}
+
+/* Set up a long copy. The owner is readied to run it. */
+static void
+ipc_copy_start(
+    struct kern *kern,
+    struct task_desc *owner,
+    struct task_desc *peer,
+    int op,
+    struct task_desc *sender,
+    struct task_desc *receiver,
+    char *dst,
+    const char *src,
+    int len)
+{
+    struct ipc_copy *copy = &kern->copies[TASK_PTR2IX(kern, owner)];
+    copy->dst         = dst;
+    copy->src         = src;
+    copy->left        = len;
+    copy->op          = op;
+    copy->sender_ix   = TASK_PTR2IX(kern, sender);
+    copy->receiver_ix = TASK_PTR2IX(kern, receiver);
+    TASK_SET_STATE(kern, peer, TASK_STATE_COPY_BLOCKED);
+    task_ready(kern, owner);
+}
+
+/* Copy a chunk at a time until done, or an IRQ comes in */
+int
+ipc_copy_resume(struct kern *kern, struct task_desc *owner)
+{
+    struct ipc_copy *copy = &kern->copies[TASK_PTR2IX(kern, owner)];
+
+    for (;;) {
+        int n = copy->left < IPC_COPY_CHUNK ? copy->left : IPC_COPY_CHUNK;
+        memcpy(copy->dst, copy->src, n);
+        copy->dst  += n;
+        copy->src  += n;
+        copy->left -= n;
+        if (copy->left == 0) {
+            ipc_copy_done(kern, copy);
+            return 0;
+        }
+        if (evt_next() >= 0) {
+            task_ready(kern, owner);
+            return 1;
+        }
+    }
+}
+
+/* Is the task running a long copy, or waiting for one? */
+bool
+ipc_copy_busy(struct kern *kern, struct task_desc *td)
+{
+    return kern->copies[TASK_PTR2IX(kern, td)].left > 0
+        || TASK_STATE(kern, td) == TASK_STATE_COPY_BLOCKED;
+}
+
+/* Put both tasks where they'd be after a short copy */
+static void
+ipc_copy_done(struct kern *kern, struct ipc_copy *copy)
+{
+    struct task_desc *sender   = TASK_IX2PTR(kern, copy->sender_ix);
+    struct task_desc *receiver = TASK_IX2PTR(kern, copy->receiver_ix);
+
+    copy->left = 0;
+    if (copy->op == IPC_COPY_MSG) {
+        TASK_SET_STATE(kern, sender, TASK_STATE_REPLY_BLOCKED);
+        task_ready(kern, receiver);
+    } else {
+        task_ready(kern, sender);
+        task_ready(kern, receiver);
+    }
+
+    /* Destroy() was waiting for the copy */
+    if (sender->doomed)
+        kern_destroy(kern, sender);
+    if (receiver->doomed)
+        kern_destroy(kern, receiver);
+}
+
+/* Put every transaction on the free list */
+COLD void
+ipc_txn_init(struct kern *kern)
+{
+    int i;
+    for (i = 0; i < IPC_TXN_MAX; i++) {
+        struct ipc_txn *txn = &kern->txns[i];
+        txn->state   = TXN_FREE;
+        txn->seq     = 0;
+        txn->next_ix = i + 1 < IPC_TXN_MAX ? i + 1 : TXN_IX_NULL;
+    }
+    kern->txn_free = 0;
+}
+
+/* Start a transaction: the message waits to be received like a Send(),
+   but the client carries on */
+HOT void
+ipc_send_async_start(struct kern *kern, struct task_desc *active)
+{
+    struct task_desc *srv;
+    struct ipc_txn *txn;
+    int rc;
+    uint8_t ix;
+
+    rc = get_task(kern, SEND_ARG_TID(active), &srv);
+    if (rc != GET_TASK_SUCCESS)
+        goto out;
+
+    if (SEND_ARG_MSGLEN(active) < 0
+        || SEND_ARG_MSGLEN(active) > IPC_COPY_CHUNK
+        || SEND_ARG_RPLYLEN(active) < 0
+        || SEND_ARG_RPLYLEN(active) > IPC_COPY_CHUNK) {
+        rc = -4;
+        goto out;
+    }
+
+    if (kern->txn_free == TXN_IX_NULL) {
+        rc = -3;
+        goto out;
+    }
+
+    ix             = kern->txn_free;
+    txn            = &kern->txns[ix];
+    kern->txn_free = txn->next_ix;
+    txn->msg       = SEND_ARG_MSG(active);
+    txn->msglen    = SEND_ARG_MSGLEN(active);
+    txn->rply      = SEND_ARG_RPLY(active);
+    txn->rplylen   = SEND_ARG_RPLYLEN(active);
+    txn->state     = TXN_QUEUED;
+    txn->client_ix = TASK_PTR2IX(kern, active);
+    txn->server_ix = TASK_PTR2IX(kern, srv);
+    txn->next_ix   = TXN_IX_NULL;
+    rc = ipc_txn_handle(kern, txn);
+
+    if (TASK_STATE(kern, srv) == TASK_STATE_SEND_BLOCKED) {
+        ipc_txn_deliver(kern, txn, srv);
+    } else {
+        if (srv->txn_tail == TXN_IX_NULL)
+            srv->txn_head = ix;
+        else
+            kern->txns[srv->txn_tail].next_ix = ix;
+        srv->txn_tail = ix;
+    }
+
+out:
+    active->regs->r0 = rc;
+    task_ready(kern, active);
+}
+
+/* Collect a finished transaction, or wait for one */
+HOT void
+ipc_await_reply_start(struct kern *kern, struct task_desc *active)
+{
+    const int *handles = (const int*)active->regs->r0;
+    int n = (int)active->regs->r1;
+    int i, pending = 0;
+
+    if (n < 0 || n > IPC_TXN_MAX) {
+        active->regs->r0 = -1;
+        task_ready(kern, active);
+        return;
+    }
+
+    for (i = 0; i < n; i++) {
+        struct ipc_txn *txn;
+        if (handles[i] < 0)
+            continue;
+        txn = ipc_txn_get(kern, handles[i]);
+        if (txn == NULL || txn->client_ix != TASK_PTR2IX(kern, active)) {
+            active->regs->r0 = -2;
+            task_ready(kern, active);
+            return;
+        }
+        if (txn->state == TXN_DONE) {
+            ipc_txn_collect(kern, active, txn, i);
+            task_ready(kern, active);
+            return;
+        }
+        pending++;
+    }
+
+    if (pending == 0) {
+        active->regs->r0 = -1;
+        task_ready(kern, active);
+        return;
+    }
+
+    /* The handles stay in r0/r1 for ipc_txn_complete() to look at */
+    TASK_SET_STATE(kern, active, TASK_STATE_TXN_BLOCKED);
+}
+
+/* A transaction's handle, as returned by SendAsync() */
+static HOT int
+ipc_txn_handle(struct kern *kern, struct ipc_txn *txn)
+{
+    return (txn->seq << 8) | (txn - kern->txns);
+}
+
+/* Look up a live transaction by handle, or NULL */
+static HOT struct ipc_txn*
+ipc_txn_get(struct kern *kern, int handle)
+{
+    struct ipc_txn *txn;
+    int ix = handle & 0xff;
+
+    if ((handle & ~0xffff) != 0 || ix >= IPC_TXN_MAX)
+        return NULL;
+
+    txn = &kern->txns[ix];
+    if (txn->state == TXN_FREE || txn->seq != (handle >> 8))
+        return NULL;
+    return txn;
+}
+
+static void
+ipc_txn_free(struct kern *kern, struct ipc_txn *txn)
+{
+    txn->state     = TXN_FREE;
+    txn->seq++;
+    txn->next_ix   = kern->txn_free;
+    kern->txn_free = txn - kern->txns;
+}
+
+/* Return from Receive() with a transaction's message */
+static HOT void
+ipc_txn_deliver(
+    struct kern *kern,
+    struct ipc_txn *txn,
+    struct task_desc *receiver)
+{
+    int copy_msglen = txn->msglen;
+    if (copy_msglen > RECV_ARG_MSGLEN(receiver))
+        copy_msglen = RECV_ARG_MSGLEN(receiver);
+
+    memcpy(RECV_ARG_MSG(receiver), txn->msg, copy_msglen);
+    *RECV_ARG_PTID(receiver) = TXN_TID(ipc_txn_handle(kern, txn));
+    receiver->regs->r0 = txn->msglen;
+    txn->state = TXN_RECEIVED;
     task_ready(kern, receiver);
 }
+
+/* Reply to a transaction. Both buffers are at most IPC_COPY_CHUNK, so
+   this is always copied in one go. */
+static HOT int
+ipc_txn_reply(struct kern *kern, tid_t tid, const char *buf, int len)
+{
+    struct ipc_txn *txn;
+    int copy_len, rc = 0;
+
+    txn = ipc_txn_get(kern, TXN_TID_HANDLE(tid));
+    if (txn == NULL)
+        return GET_TASK_NO_SUCH_TASK;
+    if (txn->state != TXN_RECEIVED)
+        return -3;
+    if (txn->client_ix == TASK_IX_NULL) {
+        /* The client is gone */
+        ipc_txn_free(kern, txn);
+        return GET_TASK_NO_SUCH_TASK;
+    }
+
+    copy_len = len;
+    if (copy_len > txn->rplylen) {
+        copy_len = txn->rplylen;
+        rc = -4;
+    }
+    memcpy(txn->rply, buf, copy_len);
+    ipc_txn_complete(kern, txn, len);
+    return rc;
+}
+
+/* Finish a transaction, handing it to the client if it's waiting */
+static HOT void
+ipc_txn_complete(struct kern *kern, struct ipc_txn *txn, int result)
+{
+    struct task_desc *client = TASK_IX2PTR(kern, txn->client_ix);
+    const int *handles;
+    int i, n, handle;
+
+    txn->state  = TXN_DONE;
+    txn->result = result;
+    if (TASK_STATE(kern, client) != TASK_STATE_TXN_BLOCKED)
+        return;
+
+    handles = (const int*)client->regs->r0;
+    n       = (int)client->regs->r1;
+    handle  = ipc_txn_handle(kern, txn);
+    for (i = 0; i < n; i++) {
+        if (handles[i] == handle) {
+            ipc_txn_collect(kern, client, txn, i);
+            task_ready(kern, client);
+            return;
+        }
+    }
+}
+
+/* Return from AwaitReply() with handles[i], and free it */
+static HOT void
+ipc_txn_collect(
+    struct kern *kern,
+    struct task_desc *client,
+    struct ipc_txn *txn,
+    int i)
+{
+    int *result = (int*)client->regs->r2;
+    if (result != NULL)
+        *result = txn->result;
+    client->regs->r0 = i;
+    ipc_txn_free(kern, txn);
+}
@@ -23,14 +23,80 @@
 
 #include "task.h"
 #include "kern.h"
+#include "event_flags.h"
 
 /* Immediate work for Send() system call. */
 void ipc_send_start(struct kern *kern, struct task_desc *active);
 
+/* Set up the pool of SendAsync() transactions */
+void ipc_txn_init(struct kern *kern);
+
+/* Immediate work for SendAsync() system call. */
+void ipc_send_async_start(struct kern *kern, struct task_desc *active);
+
+/* Immediate work for AwaitReply() system call. */
+void ipc_await_reply_start(struct kern *kern, struct task_desc *active);
+
 /* Immediate work for Receive() system call. */
 void ipc_receive_start(struct kern *kern, struct task_desc *active);
 
+/* Complete a Receive() with an interrupt message from EVT_TID(irq).
+ * The receiver must be blocked in Receive(). */
+void ipc_event_deliver(
+    struct kern *kern,
+    struct task_desc *receiver,
+    int irq,
+    const struct evt_msg *msg);
+
 /* Immediate work for Reply() system call. */
 void ipc_reply_start(struct kern *kern, struct task_desc *active);
 
+/* Immediate work for ReplyMulti() system call. */
+void ipc_reply_multi_start(struct kern *kern, struct task_desc *active);
+
+/* Reply to tid, readying it. Returns Reply()'s result. If replier is
+ * given, a long reply is copied in chunks as replier's continuation;
+ * replier is readied when it's done. */
+int ipc_reply(
+    struct kern *kern,
+    tid_t tid,
+    const char *buf,
+    int len,
+    struct task_desc *replier);
+
+/* Kinds of struct ipc_copy */
+enum {
+    IPC_COPY_MSG,
+    IPC_COPY_REPLY,
+};
+
+/* Does this task have a long copy in progress? If so, the kernel runs
+ * ipc_copy_resume() when it's scheduled, instead of switching to it. */
+#define IPC_COPY_PENDING(kern, td) \
+    ((kern)->copies[TASK_PTR2IX(kern, td)].left > 0)
+
+/* Continue a task's long copy, up to the next pending IRQ. Returns 0
+ * when the copy is done and both tasks are back in their usual states,
+ * or 1 if an IRQ interrupted it. The task is back on its ready queue
+ * either way. */
+int ipc_copy_resume(struct kern *kern, struct task_desc *owner);
+
+/* Is the task part of a long copy, either running it or waiting for
+ * it in TASK_STATE_COPY_BLOCKED? */
+bool ipc_copy_busy(struct kern *kern, struct task_desc *td);
+
+/* Withdraw a task that is being destroyed from a Send() it is waiting
+ * for a Receive() on. */
+void ipc_cancel(struct kern *kern, struct task_desc *td);
+
+/* Fail every Send() to a task that is going away with -2: both those
+ * still waiting to be received, and those waiting for a reply. The
+ * same goes for SendAsync() transactions. */
+void ipc_abort(struct kern *kern, struct task_desc *td);
+
+/* Drop the SendAsync() transactions of a task that is going away. Any
+ * its server has already received are left for the server to Reply()
+ * to, which then fails with -2. Call before ipc_abort(). */
+void ipc_txn_drop(struct kern *kern, struct task_desc *td);
+
 #endif
@@ -34,12 +34,15 @@
 #include "xassert.h"
 #include "xmemcpy.h"
 #include "array_size.h"
+#include "section.h"
 
 #include "ctx_switch.h"
 #include "intr_type.h"
 #include "intr.h"
 #include "timer.h"
+#include "ktimer.h"
 #include "syscall.h"
+#include "batch.h"
 #include "link.h"
 
 #include "u_syscall.h"
@@ -49,6 +52,7 @@
 #include "bwio.h"
 
 #include "exc_vec.h"
+#include "idle.h"
 
 #ifdef HARD_FLOAT
 #include "vfp.h"
@@ -57,23 +61,44 @@
 /* Forward declarations of helper functions */
 static void kern_top_pct(uint32_t total, uint32_t amt);
 static void kern_top(struct kern *kern, uint32_t total_time);
+static void kern_handle_event(struct kern *kern, int irq);
+static void kern_drain_irq(struct kern *kern, int irq);
+static void kern_task_exit(struct kern *kern, struct task_desc *td);
+static void kern_Destroy(struct kern *kern, struct task_desc *active);
+static void kern_Park(struct kern *kern, struct task_desc *active);
+static void kern_Unpark(struct kern *kern, struct task_desc *active);
 static void kern_RegisterCleanup(struct kern *kern, struct task_desc *active);
 static void kern_RegisterEvent(struct kern *kern, struct task_desc *active);
+static void kern_RegisterFiq(struct kern *kern, struct task_desc *active);
 static void kern_AwaitEvent(struct kern *kern, struct task_desc *active);
-static void kern_idle(void);
+static void kern_Batch(struct kern *kern, struct task_desc *active);
+static void kern_SetEventLimit(struct kern *kern, struct task_desc *active);
+static void kern_EventStats(struct kern *kern, struct task_desc *active);
+static void kern_event_return(struct task_desc *td, int irq, int rc);
+static void kern_idle_wake(struct kern *kern, struct task_desc *active);
+static void kern_idle_dispatch(struct kern *kern, struct task_desc *active);
+static void kern_idle(struct kidle *idle);
+static void kern_ktimer_arm(
+    struct kern *kern,
+    struct task_desc *active,
+    uint32_t now);
 
 /* Default kernel parameters */
 struct kparam def_kparam = {
     .init       = &u_init_main,
     .init_prio  = U_INIT_PRIORITY,
-    .show_top   = true
+    .show_top   = true,
+    .show_wcet  = false,
+    .idle_hook  = NULL,
+    .cyclic     = NULL
 };
 
 int
 kern_main(struct kparam *kp)
 {
-    struct kern kern;
-    uint32_t start_time, end_time, time;
+    /* Static, so that it can be cache line aligned */
+    static struct kern kern;
+    uint32_t start_time, end_time, time, now;
 
     /* Set up kernel state and create initial user task */
     kern_init(&kern, kp);
@@ -87,6 +112,16 @@ kern_main(struct kparam *kp)
              (unsigned int)UserStacksEnd,
              (unsigned int)UserStacksStart,
              (unsigned int)kern.user_stack_size);
+    bwprintf("OCMC Stacks -- Bottom: %x Top: %x Size: %d bytes\n\r",
+             (unsigned int)OcmcStacksEnd,
+             (unsigned int)OcmcStacksStart,
+             OCMC_STACK_SIZE);
+    bwprintf("Hot Code (OCMC) -- Start: %x End: %x\n\r",
+             (unsigned int)HotStart,
+             (unsigned int)HotEnd);
+    bwprintf("Cold Code (DDR) -- Start: %x End: %x\n\r",
+             (unsigned int)ColdStart,
+             (unsigned int)ColdEnd);
     
     /* Main loop */
     start_time = dbg_tmr_get() / 1000;
@@ -94,12 +129,44 @@ kern_main(struct kparam *kp)
     /* Run the scheduler now to avoid uninitialized warnings */
     int skip_sched = 0;
     struct task_desc *active = NULL;
-    while (!kern.shutdown && (kern.rdy_count > 1 || kern.evblk_count > 0)) {
+    while (!kern.shutdown
+           && (kern.rdy_count > 1
+               || kern.evblk_count > 0
+               || kern.eventab.msg_count > 0
+               || kern.budget.throttled > 0
+               || kern.period.waiting > 0
+               || kern.cyclic.table != NULL)) {
         uint32_t          intr;
 
         /* Conditionally run the scheduler */
         if (!skip_sched) {
-            active = task_schedule(&kern);
+            if (kern.budget.throttled > 0
+                || kern.period.waiting > 0
+                || kern.cyclic.table != NULL) {
+                now = dbg_tmr_ticks();
+                budget_replenish(&kern, now);
+                period_release(&kern, now);
+                cyclic_advance(&kern, now);
+            }
+            active = cyclic_schedule(&kern);
+
+            /* Tasks out of CPU budget wait for it to be restored */
+            if (BUDGET_EXHAUSTED(&kern, active)
+                && budget_throttle(&kern, active, dbg_tmr_ticks()))
+                continue;
+
+            /* A long message copy runs here in the kernel, on behalf of
+               the task that owns it, and at its priority: IRQs that
+               could preempt the task are serviced between chunks. */
+            if (IPC_COPY_PENDING(&kern, active)) {
+                int irq;
+                wcet_split(&kern.wcet, WCET_COPY);
+                evt_threshold(&kern.eventab, TASK_PRIO(&kern, active));
+                if (ipc_copy_resume(&kern, active)
+                    && (irq = evt_next()) >= 0)
+                    kern_drain_irq(&kern, irq);
+                continue;
+            }
 
 #ifdef HARD_FLOAT
             /* If the task we just scheduled has a stored floating
@@ -136,16 +203,33 @@ kern_main(struct kparam *kp)
 #endif
         }
 
-        time   = dbg_tmr_get() / 1000;
+        /* Only interrupts whose handlers are at least as important
+           as the task we're about to run may preempt it. Rate limited
+           IRQs come back once their window is over; this is checked
+           on every kernel exit, so the resolution is bounded by the
+           clock tick. */
+        evt_unthrottle(&kern.eventab);
+        evt_threshold(&kern.eventab, TASK_PRIO(&kern, active));
+
+        kern_idle_dispatch(&kern, active);
+
+        time   = dbg_tmr_ticks();
+        kern_ktimer_arm(&kern, active, time);
+        wcet_exit(&kern.wcet);
         intr   = ctx_switch(active);
-        active->time += (dbg_tmr_get() / 1000) - time;
+        wcet_enter(&kern.wcet);
+        now    = dbg_tmr_ticks();
+        active->time += now / (DBG_TMR_HZ / 1000) - time / (DBG_TMR_HZ / 1000);
+        budget_charge(&kern, active, time, now);
+        if (intr == INTR_IRQ)
+            kern_idle_wake(&kern, active);
 #ifdef HARD_FLOAT
         vfp_disable();
 #endif
         skip_sched = kern_handle_intr(&kern, active, intr);
 
         /* Either the active task is no longer active, or we're skipping the scheduler */
-        assert((TASK_STATE(active) != TASK_STATE_ACTIVE) || skip_sched);
+        assert((TASK_STATE(&kern, active) != TASK_STATE_ACTIVE) || skip_sched);
     }
 
     end_time = dbg_tmr_get() / 1000;
@@ -153,6 +237,8 @@ kern_main(struct kparam *kp)
 
     if (kp->show_top)
         kern_top(&kern, end_time - start_time);
+    if (kp->show_wcet)
+        wcet_print(&kern.wcet);
 
     return 0;
 }
@@ -160,7 +246,7 @@ kern_main(struct kparam *kp)
 void
 kern_init(struct kern *kern, struct kparam *kp)
 {
-    uint32_t i, mem_avail;
+    uint32_t i, n, mem_avail;
     tid_t tid;
 
     /* Load kernel exception vector table */
@@ -180,13 +266,19 @@ kern_init(struct kern *kern, struct kparam *kp)
     mem_avail = UserStacksEnd - UserStacksStart;
     kern->user_stack_size = mem_avail / PAGE_SIZE / MAX_TASKS * PAGE_SIZE;
 
+    /* So are all the stacks in on-chip RAM */
+    n = ((char*)OcmcStacksEnd - (char*)OcmcStacksStart) / OCMC_STACK_SIZE;
+    if (n > 32)
+        n = 32;
+    kern->ocmc_free = n == 32 ? ~0u : (1u << n) - 1;
+
     /* All tasks are free to begin with */
     taskq_init(&kern->free_tasks);
     for (i = 0; i < MAX_TASKS; i++) {
         struct task_desc *td = &kern->tasks[i];
-        td->state_prio = TASK_STATE_FREE; /* prio is arbitrary on init */
-        td->tid_seq    = 0;
-        td->next_ix    = TASK_IX_NOTINQUEUE;
+        kern->state_prio[i] = TASK_STATE_FREE; /* prio is arbitrary on init */
+        kern->next_ix[i]    = TASK_IX_NOTINQUEUE;
+        td->tid_seq         = 0;
         task_enqueue(kern, td, &kern->free_tasks);
     }
 
@@ -201,16 +293,50 @@ kern_init(struct kern *kern, struct kparam *kp)
     kern->rdy_count   = 0;
     kern->evblk_count = 0;
 
-    /* Start special tasks: idle and init. Each is its own parent. */
-    tid = task_create(kern, 0, PRIORITY_IDLE, kern_idle);
+    /* No long copies are under way */
+    for (i = 0; i < MAX_TASKS; i++)
+        kern->copies[i].left = 0;
+
+    /* Nor any transactions */
+    ipc_txn_init(kern);
+
+    /* Nothing measured yet */
+    wcet_init(&kern->wcet);
+
+    /* No task has a CPU budget or a period */
+    ktimer_init();
+    kern->ktimer_armed = false;
+    budget_init(kern);
+    period_init(kern);
+    cyclic_init(kern, kp->cyclic);
+
+    /* No mailboxes yet */
+    mbox_init(kern);
+
+    /* Nothing has slept yet */
+    kern->idle.hook        = kp->idle_hook;
+    kern->idle.sleep_start = 0;
+    kern->idle.sleep_time  = 0;
+    kern->idle.wakeups     = 0;
+    kern->idle.wake_time   = 0;
+    kern->idle.waking      = false;
+    kern->idle.lat_count   = 0;
+    kern->idle.lat_total   = 0;
+    kern->idle.lat_max     = 0;
+
+    /* Start special tasks: idle and init. Each is its own parent.
+       The idle task gets its state as an argument. */
+    tid = task_create(
+        kern, 0, PRIORITY_IDLE, (void (*)(void))kern_idle, NULL, 0);
     assertv(tid, tid == 0);
-    tid = task_create(kern, 1, kp->init_prio, kp->init);
+    kern->tasks[0].regs->r0 = (uint32_t)&kern->idle;
+    tid = task_create(kern, 1, kp->init_prio, kp->init, NULL, 0);
     assertv(tid, tid == 1);
 }
 
 /* Handle an interrupt. Return non-zero to skip the scheduler and continue
    running active. */
-int
+HOT int
 kern_handle_intr(struct kern *kern, struct task_desc *active, uint32_t intr)
 {
     switch (intr) {
@@ -231,17 +357,39 @@ kern_handle_intr(struct kern *kern, struct task_desc *active, uint32_t intr)
 }
 
 /* Handle a software interrupt */
-void
+HOT void
 kern_handle_swi(struct kern *kern, struct task_desc *active)
 {
-    uint32_t syscall = *((uint32_t*)active->regs->pc - 1) & 0x00ffffff;
+    uint32_t syscall;
+
+    /* Syscall number is the SWI immediate. Thumb SVC only has 8 bits. */
+    if (active->regs->spsr & PSR_THUMB)
+        syscall = *((uint16_t*)active->regs->pc - 1) & 0xff;
+    else
+        syscall = *((uint32_t*)active->regs->pc - 1) & 0x00ffffff;
+
+    if (syscall < SYSCALL_COUNT)
+        wcet_charge(&kern->wcet, WCET_SWI + syscall);
+
     switch (syscall) {
     case SYSCALL_CREATE:
         active->regs->r0 = (uint32_t)task_create(
             kern,
             TASK_PTR2IX(kern, active),
             (int)active->regs->r0,
-            (void(*)(void))active->regs->r1);
+            (void(*)(void))active->regs->r1,
+            NULL,
+            0);
+        task_ready(kern, active);
+        break;
+    case SYSCALL_CREATEARG:
+        active->regs->r0 = (uint32_t)task_create(
+            kern,
+            TASK_PTR2IX(kern, active),
+            (int)active->regs->r0,
+            (void(*)(void))active->regs->r1,
+            (const void*)active->regs->r2,
+            (size_t)active->regs->r3);
         task_ready(kern, active);
         break;
     case SYSCALL_MYTID:
@@ -258,19 +406,29 @@ kern_handle_swi(struct kern *kern, struct task_desc *active)
         task_ready(kern, active);
         break;
     case SYSCALL_EXIT:
-        if(active->cleanup != NULL)
-            active->cleanup();
-        task_free(kern, active);
+        kern_task_exit(kern, active);
+        break;
+    case SYSCALL_DESTROY:
+        kern_Destroy(kern, active);
         break;
     case SYSCALL_SEND:
         ipc_send_start(kern, active);
         break;
+    case SYSCALL_SENDASYNC:
+        ipc_send_async_start(kern, active);
+        break;
+    case SYSCALL_AWAITREPLY:
+        ipc_await_reply_start(kern, active);
+        break;
     case SYSCALL_RECEIVE:
         ipc_receive_start(kern, active);
         break;
     case SYSCALL_REPLY:
         ipc_reply_start(kern, active);
         break;
+    case SYSCALL_REPLYMULTI:
+        ipc_reply_multi_start(kern, active);
+        break;
     case SYSCALL_REGISTERCLEANUP:
         kern_RegisterCleanup(kern, active);
         break;
@@ -280,6 +438,73 @@ kern_handle_swi(struct kern *kern, struct task_desc *active)
     case SYSCALL_AWAITEVENT:
         kern_AwaitEvent(kern, active);
         break;
+    case SYSCALL_REGISTERFIQ:
+        kern_RegisterFiq(kern, active);
+        break;
+    case SYSCALL_BATCH:
+        kern_Batch(kern, active);
+        break;
+    case SYSCALL_PARK:
+        kern_Park(kern, active);
+        break;
+    case SYSCALL_UNPARK:
+        kern_Unpark(kern, active);
+        break;
+    case SYSCALL_SETBUDGET:
+        active->regs->r0 = budget_set(
+            kern,
+            (tid_t)active->regs->r0,
+            (unsigned int)active->regs->r1,
+            (unsigned int)active->regs->r2);
+        task_ready(kern, active);
+        break;
+    case SYSCALL_BUDGETSTATS:
+        active->regs->r0 = budget_stats(
+            kern,
+            (tid_t)active->regs->r0,
+            (struct budget_stats*)active->regs->r1);
+        task_ready(kern, active);
+        break;
+    case SYSCALL_SETPERIOD:
+        active->regs->r0 = period_set(
+            kern,
+            active,
+            (unsigned int)active->regs->r0,
+            (unsigned int)active->regs->r1);
+        task_ready(kern, active);
+        break;
+    case SYSCALL_WAITPERIOD:
+        period_wait(kern, active);
+        break;
+    case SYSCALL_CYCLICWAIT:
+        cyclic_wait(kern, active);
+        break;
+    case SYSCALL_MBOXCREATE:
+        active->regs->r0 = mbox_create(
+            kern,
+            (void*)active->regs->r0,
+            (int)active->regs->r1,
+            (int)active->regs->r2,
+            (int)active->regs->r3);
+        task_ready(kern, active);
+        break;
+    case SYSCALL_POST:
+        active->regs->r0 = mbox_post(
+            kern,
+            (int)active->regs->r0,
+            (const void*)active->regs->r1,
+            (int)active->regs->r2);
+        task_ready(kern, active);
+        break;
+    case SYSCALL_FETCH:
+        mbox_fetch(kern, active);
+        break;
+    case SYSCALL_SETEVENTLIMIT:
+        kern_SetEventLimit(kern, active);
+        break;
+    case SYSCALL_EVENTSTATS:
+        kern_EventStats(kern, active);
+        break;
     case SYSCALL_SHUTDOWN:
         kern->shutdown = true;
         task_ready(kern, active); /* must move out of ACTIVE state */
@@ -291,20 +516,61 @@ kern_handle_swi(struct kern *kern, struct task_desc *active)
     }
 }
 
-/* Handle a hardware interrupt */
-void
+/* Handle a hardware interrupt. Every IRQ that is pending on entry (or
+   becomes pending meanwhile) is serviced before returning, up to
+   IRQ_DRAIN_MAX, so that the scheduler runs once for the lot. */
+HOT void
 kern_handle_irq(struct kern *kern, struct task_desc *active)
 {
     int irq;
-    struct event *evt;
-    struct task_desc *wake;
-    int rc, cb_rc;
 
     /* Interrupted task as always ready */
     task_ready(kern, active);
 
     /* Find the current event. */
     irq = evt_cur();
+    wcet_charge(&kern->wcet, WCET_IRQ + irq);
+    kern_drain_irq(kern, irq);
+}
+
+/* Service IRQs starting at the given one, until none are pending
+   or IRQ_DRAIN_MAX have been handled */
+static HOT void
+kern_drain_irq(struct kern *kern, int irq)
+{
+    int n;
+
+    for (n = 0; ; ) {
+        kern_handle_event(kern, irq);
+
+        /* Do any work needed for the interrupt controller,
+           such as clearing the global interrupt state */
+        evt_acknowledge();
+
+        if (++n >= IRQ_DRAIN_MAX)
+            break;
+        irq = evt_next();
+        if (irq < 0)
+            break;
+    }
+}
+
+/* Handle one event */
+static HOT void
+kern_handle_event(struct kern *kern, int irq)
+{
+    struct event *evt;
+    struct task_desc *wake;
+    int rc, cb_rc;
+
+    /* The kernel timer only has to get us into the kernel: budgets
+       and periods are checked on the way back out */
+    if (irq == KTIMER_IRQ) {
+        ktimer_ack();
+        kern->ktimer_armed = false;
+        return;
+    }
+
     evt = &kern->eventab.events[irq];
     assert(evt->tid >= 0);
 
@@ -314,21 +580,54 @@ kern_handle_irq(struct kern *kern, struct task_desc *active)
     if (cb_rc == -1)
         return; /* callback says to ignore this interrupt */
 
-    /* Look up the event-blocked task */
+    /* Count it, and mask the IRQ if it's storming */
+    evt_account(&kern->eventab, irq);
+
+    /* Look up the owning task */
     rc = get_task(kern, evt->tid, &wake);
     assertv(rc, rc == GET_TASK_SUCCESS);
-    assert(TASK_STATE(wake) == TASK_STATE_EVENT_BLOCKED);
-    kern->evblk_count--;
 
-    /* Ignore this interrupt until we get another AwaitEvent() for it */
-    evt_disable(&kern->eventab, irq);
+    if (evt->flags & EVT_MSG) {
+        /* Message events stay enabled. Hand the owner a message if
+           it's waiting in Receive(), otherwise latch the occurrence. */
+        if (TASK_STATE(kern, wake) == TASK_STATE_SEND_BLOCKED) {
+            struct evt_msg msg;
+            assert(evt->pending == 0);
+            msg.rc    = cb_rc;
+            msg.count = 1;
+            evt_served(&kern->eventab, &wake->irq, irq);
+            ipc_event_deliver(kern, wake, irq, &msg);
+            return;
+        }
+        if (evt->pending == 0)
+            wake->evt_pending++;
+        if (evt->pending < EVT_PENDING_MAX)
+            evt->pending++;
+        evt->rc = cb_rc;
+        return;
+    }
+
+    if (evt->flags & EVT_COUNT) {
+        /* Counting events stay enabled. If the owner is busy,
+           latch the occurrence for its next AwaitEvent(). */
+        if (TASK_STATE(kern, wake) != TASK_STATE_EVENT_BLOCKED) {
+            if (evt->pending < EVT_PENDING_MAX)
+                evt->pending++;
+            return;
+        }
+        cb_rc = 1;
+    }
 
-    /* Do any work needed for the interrupt controller,
-       such as clearing the global interrupt state */
-    evt_acknowledge();
+    assert(TASK_STATE(kern, wake) == TASK_STATE_EVENT_BLOCKED);
+    kern->evblk_count--;
+
+    /* Ignore the task's interrupts until we get another AwaitEvent(),
+       and let its other events go first next time */
+    evt_disable(&kern->eventab, wake->irq);
+    evt_served(&kern->eventab, &wake->irq, irq);
 
     /* Return from AwaitEvent() with the result of the callback */
-    wake->regs->r0 = cb_rc;
+    kern_event_return(wake, irq, cb_rc);
     task_ready(kern, wake);
 }
 
@@ -336,6 +635,8 @@ kern_handle_irq(struct kern *kern, struct task_desc *active)
 int
 kern_handle_undef(struct kern *k, struct task_desc *active)
 {
+    wcet_charge(&k->wcet, WCET_UNDEF);
+
 #ifdef HARD_FLOAT
     /* If the active task is not the floating point context holder,
        it may be that they tried to execute an fpu instruction. Give them
@@ -363,30 +664,140 @@ kern_handle_undef(struct kern *k, struct task_desc *active)
         bwprintf("Killing task for undefined instruction. TID: %d INSTR ADDR: %x\n\r", 
                  TASK_TID(k,active),
                  active->regs->pc);
-        if(active->cleanup != NULL)
-            active->cleanup();
-        task_free(k, active);
+        kern_task_exit(k, active);
         return 0;
 #ifdef HARD_FLOAT
     }
 #endif
 }
 
-/* Call all the task cleanup functiions and reset the event system */
+/* Tear down a task that isn't on any queue */
+static void
+kern_task_exit(struct kern *kern, struct task_desc *td)
+{
+    if (td->cleanup != NULL)
+        td->cleanup();
+    ipc_txn_drop(kern, td);
+    ipc_abort(kern, td);
+    cyclic_forget(kern, td);
+    task_free(kern, td);
+}
+
+/* Kill another task, wherever it's blocked */
+static void
+kern_Destroy(struct kern *kern, struct task_desc *active)
+{
+    struct task_desc *victim;
+    int rc;
+
+    rc = get_task(kern, (tid_t)active->regs->r0, &victim);
+    if (rc != GET_TASK_SUCCESS) {
+        active->regs->r0 = rc;
+        task_ready(kern, active);
+        return;
+    }
+
+    if (victim == active) {
+        kern_task_exit(kern, active);
+        return;
+    }
+
+    /* The kernel can't run without the idle task */
+    if (TASK_PTR2IX(kern, victim) == 0) {
+        active->regs->r0 = -3;
+        task_ready(kern, active);
+        return;
+    }
+
+    /* A long copy to or from the victim is left to finish a chunk at a
+       time, as usual, and the victim goes once it's done */
+    if (ipc_copy_busy(kern, victim))
+        victim->doomed = 1;
+    else
+        kern_destroy(kern, victim);
+
+    active->regs->r0 = 0;
+    task_ready(kern, active);
+}
+
+/* Take a task off whatever it's blocked on, and free it */
 void
+kern_destroy(struct kern *kern, struct task_desc *victim)
+{
+    switch (TASK_STATE(kern, victim)) {
+    case TASK_STATE_READY:
+        task_unready(kern, victim);
+        break;
+    case TASK_STATE_RECEIVE_BLOCKED:
+        ipc_cancel(kern, victim);
+        break;
+    case TASK_STATE_EVENT_BLOCKED:
+        kern->evblk_count--;
+        break;
+    case TASK_STATE_THROTTLED:
+        budget_forget(kern, victim);
+        break;
+    case TASK_STATE_PERIOD_BLOCKED:
+        period_forget(kern, victim);
+        break;
+    case TASK_STATE_FETCH_BLOCKED:
+        mbox_forget(kern, victim);
+        break;
+    default:
+        /* Blocked, but not on any queue */
+        break;
+    }
+
+    kern_task_exit(kern, victim);
+}
+
+/* Block until unparked, unless that already happened */
+static HOT void
+kern_Park(struct kern *kern, struct task_desc *active)
+{
+    active->regs->r0 = 0;
+    if (active->unparked) {
+        active->unparked = 0;
+        task_ready(kern, active);
+    } else {
+        TASK_SET_STATE(kern, active, TASK_STATE_PARKED);
+    }
+}
+
+/* Wake a parked task, or leave it a token */
+static HOT void
+kern_Unpark(struct kern *kern, struct task_desc *active)
+{
+    struct task_desc *td;
+    int rc;
+
+    rc = get_task(kern, (tid_t)active->regs->r0, &td);
+    if (rc == GET_TASK_SUCCESS) {
+        if (TASK_STATE(kern, td) == TASK_STATE_PARKED)
+            task_ready(kern, td);
+        else
+            td->unparked = 1;
+    }
+    active->regs->r0 = rc;
+    task_ready(kern, active);
+}
+
+/* Call all the task cleanup functiions and reset the event system */
+COLD void
 kern_cleanup(struct kern *kern)
 {
     unsigned int i;
     for (i = 0; i < ARRAY_SIZE(kern->tasks); i++) {
         struct task_desc *td = &kern->tasks[i];
-        if (TASK_STATE(td) != TASK_STATE_FREE && td->cleanup != NULL)
+        if (TASK_STATE(kern, td) != TASK_STATE_FREE && td->cleanup != NULL)
             td->cleanup();
     }
+    ktimer_cleanup();
     evt_cleanup();
 }
 
 /* Display a percentage */
-static void
+static COLD void
 kern_top_pct(uint32_t total, uint32_t amt)
 {
     uint32_t pct, pct10;
@@ -397,7 +808,7 @@ kern_top_pct(uint32_t total, uint32_t amt)
 }
 
 /* Print a "top" message */
-static void
+static COLD void
 kern_top(struct kern *kern, uint32_t total_time)
 {
     unsigned i;
@@ -408,7 +819,7 @@ kern_top(struct kern *kern, uint32_t total_time)
         struct task_desc *td;
         tid_t tid;
         td = &kern->tasks[i];
-        if (TASK_STATE(td) == TASK_STATE_FREE)
+        if (TASK_STATE(kern, td) == TASK_STATE_FREE)
             continue;
         tid = TASK_TID(kern, td);
         if (tid == 0)
@@ -420,6 +831,14 @@ kern_top(struct kern *kern, uint32_t total_time)
     }
     bwputstr("KERNEL");
     kern_top_pct(total_ms, (total_time - user_time));
+
+    bwputstr("SLEEP");
+    kern_top_pct(total_ms, kern->idle.sleep_time / 1000);
+    bwprintf("woke %u times, wake latency avg %u us max %u us\n\r",
+             kern->idle.wakeups,
+             kern->idle.lat_count == 0
+                 ? 0 : kern->idle.lat_total / kern->idle.lat_count,
+             kern->idle.lat_max);
 }
 
 /* Handle a cleanup function registration */
@@ -434,24 +853,26 @@ kern_RegisterCleanup(struct kern *kern, struct task_desc *active)
 static void
 kern_RegisterEvent(struct kern *kern, struct task_desc *active)
 {
-    int rc, irq;
-    if (active->irq >= 0) {
-        active->regs->r0 = EVT_DBL_REG;
-        task_ready(kern, active);
-        return;
-    }
-
-    irq = (int)active->regs->r0;
-    rc  = evt_register(
+    active->regs->r0 = evt_register(
         &kern->eventab,
         TASK_TID(kern, active),
-        irq,
-        (int(*)(void*,size_t))active->regs->r1);
-
-    active->regs->r0 = rc;
-    if (rc == 0)
-        active->irq = irq;
+        &active->irq,
+        (int)active->regs->r0,
+        (int)active->regs->r1,
+        (unsigned int)active->regs->r2,
+        (int(*)(void*,size_t))active->regs->r3);
+    task_ready(kern, active);
+}
 
+/* Handle a FIQ fast path registration request */
+static void
+kern_RegisterFiq(struct kern *kern, struct task_desc *active)
+{
+    active->regs->r0 = evt_register_fiq(
+        &kern->eventab,
+        TASK_TID(kern, active),
+        (int)active->regs->r0,
+        (struct fiq_chan*)active->regs->r1);
     task_ready(kern, active);
 }
 
@@ -459,12 +880,28 @@ kern_RegisterEvent(struct kern *kern, struct task_desc *active)
 static void
 kern_AwaitEvent(struct kern *kern, struct task_desc *active)
 {
+    int irq, rc;
     if (active->irq < 0) {
         active->regs->r0 = -1;
         task_ready(kern, active);
+        return;
+    }
+
+    /* Return straight away if any of the task's events already
+       happened: latched counts, or IRQs that are still asserted */
+    if (evt_poll(
+            &kern->eventab,
+            &active->irq,
+            (void*)active->regs->r0,
+            (size_t)active->regs->r1,
+            &irq,
+            &rc)) {
+        kern_event_return(active, irq, rc);
+        task_ready(kern, active);
+        return;
     }
 
-    TASK_SET_STATE(active, TASK_STATE_EVENT_BLOCKED);
+    TASK_SET_STATE(kern, active, TASK_STATE_EVENT_BLOCKED);
     evt_enable(
         &kern->eventab,
         active->irq,
@@ -473,11 +910,173 @@ kern_AwaitEvent(struct kern *kern, struct task_desc *active)
     kern->evblk_count++;
 }
 
-/* Kernel Idle Task */
+/* Handle a batch of operations */
 static void
-kern_idle(void)
+kern_Batch(struct kern *kern, struct task_desc *active)
+{
+    struct batch_op *ops = (struct batch_op*)active->regs->r0;
+    int i, n = (int)active->regs->r1;
+
+    for (i = 0; i < n; i++) {
+        struct batch_op *op = &ops[i];
+        switch (op->op) {
+        case BATCH_REPLY:
+            /* Copied whole, in among the other operations */
+            if (op->len > IPC_COPY_CHUNK) {
+                op->rc = BATCH_TOO_LONG;
+                break;
+            }
+            op->rc = ipc_reply(kern, op->tid, op->buf, op->len, NULL);
+            break;
+        case BATCH_POST:
+            op->rc = mbox_post(kern, op->tid, op->buf, op->len);
+            break;
+        case BATCH_RECEIVE:
+            if (i != n - 1) {
+                op->rc = BATCH_NOT_LAST;
+                break;
+            }
+            /* Finish as if this were a Receive() */
+            active->regs->r0 = (uint32_t)&op->tid;
+            active->regs->r1 = (uint32_t)op->buf;
+            active->regs->r2 = (uint32_t)op->len;
+            ipc_receive_start(kern, active);
+            return;
+        case BATCH_AWAITEVENT:
+            if (i != n - 1) {
+                op->rc = BATCH_NOT_LAST;
+                break;
+            }
+            /* Finish as if this were an AwaitEvent() */
+            active->regs->r0 = (uint32_t)op->buf;
+            active->regs->r1 = (uint32_t)op->len;
+            active->regs->r2 = (uint32_t)NULL;
+            kern_AwaitEvent(kern, active);
+            return;
+        default:
+            op->rc = BATCH_BAD_OP;
+            break;
+        }
+    }
+
+    active->regs->r0 = n < 0 ? -1 : 0;
+    task_ready(kern, active);
+}
+
+/* Handle a request to rate limit an event */
+static void
+kern_SetEventLimit(struct kern *kern, struct task_desc *active)
+{
+    active->regs->r0 = evt_limit(
+        &kern->eventab,
+        TASK_TID(kern, active),
+        (int)active->regs->r0,
+        (unsigned int)active->regs->r1,
+        (uint32_t)active->regs->r2);
+    task_ready(kern, active);
+}
+
+/* Handle a request for event counters */
+static void
+kern_EventStats(struct kern *kern, struct task_desc *active)
+{
+    active->regs->r0 = evt_stats(
+        &kern->eventab,
+        (int)active->regs->r0,
+        (struct evt_stats*)active->regs->r1);
+    task_ready(kern, active);
+}
+
+/* Set the return values of AwaitEvent(). The caller's optional
+   IRQ output pointer is still in its r2. */
+static void
+kern_event_return(struct task_desc *td, int irq, int rc)
+{
+    int *irq_out = (int*)td->regs->r2;
+    if (irq_out != NULL)
+        *irq_out = irq;
+    td->regs->r0 = rc;
+}
+
+/* Account for an IRQ. If it woke the idle task out of WFI,
+   count the time slept and start timing the wake-up. */
+static void
+kern_idle_wake(struct kern *kern, struct task_desc *active)
+{
+    uint32_t now, pc;
+    if (active != &kern->tasks[0])
+        return;
+
+    pc = active->regs->pc;
+    if (pc != (uint32_t)cpu_idle_wake) {
+        /* Interrupted after the stamp but before the WFI: start over,
+           or the other tasks' time would be counted as sleep */
+        if (pc > (uint32_t)cpu_idle && pc < (uint32_t)cpu_idle_wake)
+            active->regs->pc = (uint32_t)cpu_idle;
+        return;
+    }
+
+    now = dbg_tmr_ticks();
+    kern->idle.sleep_time +=
+        (now - kern->idle.sleep_start) / DBG_TMR_TICKS_PER_US;
+    kern->idle.wakeups++;
+    kern->idle.wake_time = now;
+    kern->idle.waking    = true;
+}
+
+/* About to run a task. If it's the first one since waking up,
+   record how long it took to get here from WFI. */
+static void
+kern_idle_dispatch(struct kern *kern, struct task_desc *active)
+{
+    uint32_t lat;
+    if (!kern->idle.waking)
+        return;
+
+    kern->idle.waking = false;
+    if (active == &kern->tasks[0])
+        return; /* nothing was woken */
+
+    lat = (dbg_tmr_ticks() - kern->idle.wake_time) / DBG_TMR_TICKS_PER_US;
+    kern->idle.lat_count++;
+    kern->idle.lat_total += lat;
+    if (lat > kern->idle.lat_max)
+        kern->idle.lat_max = lat;
+}
+
+/* Set the kernel timer for whichever comes first: the active task
+   running out of budget, the next periodic release, or the next
+   cyclic executive slot boundary. */
+static HOT void
+kern_ktimer_arm(struct kern *kern, struct task_desc *active, uint32_t now)
+{
+    uint32_t ticks, release;
+
+    ticks   = budget_next(kern, active, now);
+    release = period_next(kern, now);
+    if (release < ticks)
+        ticks = release;
+    release = cyclic_next(kern, now);
+    if (release < ticks)
+        ticks = release;
+
+    if (ticks != KTIMER_NEVER) {
+        ktimer_arm(ticks);
+        kern->ktimer_armed = true;
+    } else if (kern->ktimer_armed) {
+        ktimer_disarm();
+        kern->ktimer_armed = false;
+    }
+}
+
+/* Kernel Idle Task. Runs deferred work while there is any,
+   otherwise sleeps until the next interrupt. */
+static void
+kern_idle(struct kidle *idle)
 {
     for (;;) {
-        /* Do nothing */
+        if (idle->hook != NULL && idle->hook())
+            continue;
+        cpu_idle(&idle->sleep_start);
     }
 }
@@ -24,34 +24,123 @@
 #include "xbool.h"
 #include "xint.h"
 #include "xdef.h"
+#include "static_assert.h"
+#include "section.h"
 #include "task.h"
 #include "event.h"
+#include "wcet.h"
+#include "budget.h"
+#include "period.h"
+#include "cyclic.h"
+#include "mbox.h"
+
+/* Idle task state, shared between the idle task and the kernel.
+ * Times are in microseconds. */
+struct kidle {
+    int    (*hook)(void);       /* deferred work hook, see kparam */
+    volatile uint32_t sleep_start; /* ticks, stamped by cpu_idle() */
+    uint32_t sleep_time;        /* total time spent in WFI, us */
+    uint32_t wakeups;           /* number of times WFI was left */
+    uint32_t wake_time;         /* kernel entry out of WFI, ticks */
+    bool     waking;            /* woken, no other task dispatched yet */
+    uint32_t lat_count;         /* wake-ups that dispatched a task */
+    uint32_t lat_total;         /* WFI exit to dispatch, summed */
+    uint32_t lat_max;
+};
 
-struct kern {
-#ifdef HARD_FLOAT
-    struct task_desc* fp_ctx_holder;
-#endif
+/* A message copy too long to do in one go. It belongs to the task
+ * whose system call started it, which stays on its ready queue until
+ * the copy is done; the other task is COPY_BLOCKED meanwhile. */
+struct ipc_copy {
+    char       *dst;
+    const char *src;
+    int         left;        /* bytes still to copy, or 0 if none */
+    uint8_t     op;          /* IPC_COPY_MSG or IPC_COPY_REPLY */
+    uint8_t     sender_ix;
+    uint8_t     receiver_ix; /* receiver, or replier for a reply */
+};
 
-    void             *user_stacks_bottom;
-    size_t            user_stack_size;
-    struct task_desc  tasks[MAX_TASKS];
+/* A SendAsync() transaction. The client's buffers stay in place until
+ * AwaitReply() collects the result, as they would in a blocked Send(). */
+struct ipc_txn {
+    const char *msg;
+    int         msglen;
+    char       *rply;
+    int         rplylen;
+    int         result;    /* for AwaitReply(), once TXN_DONE */
+    uint8_t     state;     /* TXN_* */
+    uint8_t     seq;       /* bumped on reuse, so stale handles fail */
+    uint8_t     client_ix; /* TASK_IX_NULL if the client has exited */
+    uint8_t     server_ix;
+    uint8_t     next_ix;   /* server's queue, or the free list */
+};
+
+enum {
+    TXN_FREE,
+    TXN_QUEUED,    /* waiting for the server to Receive() it */
+    TXN_RECEIVED,  /* waiting for the server to Reply() */
+    TXN_DONE       /* waiting for the client to AwaitReply() */
+};
+
+#define TXN_IX_NULL 0xff
+
+/* Kernel state. The scheduler's working set is packed into the first
+ * cache line; per-task state and queue links are kept as arrays apart
+ * from the descriptors, so that walking a queue or scanning task states
+ * touches two lines instead of one per task. */
+struct kern {
     uint16_t          rdy_queue_ne; /* bit i set if queue i nonempty */
     struct task_queue rdy_queues[N_PRIORITIES];
     struct task_queue free_tasks;
-    struct eventab    eventab;
 
     /* Termination control. Kernel exits either when there has been a
-     * shutdown request, or when no tasks are ready or event-blocked. */
+     * shutdown request, or when no tasks are ready or event-blocked and
+     * no task is registered to receive interrupt messages. */
     bool shutdown;
     int  rdy_count;
     int  evblk_count;
+
+#ifdef HARD_FLOAT
+    struct task_desc* fp_ctx_holder;
+#endif
+    uint32_t          ocmc_free; /* bit i set if OCMC stack i is free */
+    void             *user_stacks_bottom;
+    size_t            user_stack_size;
+
+    /* Indexed by task descriptor index, see TASK_STATE() and TASK_NEXT() */
+    uint8_t           state_prio[MAX_TASKS] CACHE_ALIGNED;
+    uint8_t           next_ix[MAX_TASKS];
+
+    struct task_desc  tasks[MAX_TASKS] CACHE_ALIGNED;
+    struct eventab    eventab CACHE_ALIGNED;
+    struct kidle      idle;
+    struct ipc_copy   copies[MAX_TASKS]; /* by owner's index */
+    struct ipc_txn    txns[IPC_TXN_MAX];
+    uint8_t           txn_free;          /* free list head */
+    struct wcet       wcet;
+    struct budgets    budget;
+    struct periods    period;
+    struct cyclic     cyclic;
+    struct mboxes     mbox;
+    bool              ktimer_armed;
 };
+STATIC_ASSERT(kern_sched_line, offsetof (struct kern, state_prio) == CACHE_LINE);
 
 struct kparam {
     /* Initial user task entry point and priority. */
     void (*init)(void);
     int  init_prio;
     bool show_top; /* print the time taken by each task? */
+    bool show_wcet; /* print kernel path lengths? (needs KERN_WCET) */
+
+    /* Deferred low priority work, run by the idle task before it
+     * sleeps. Returns non-zero if there is more work to do right away.
+     * Runs in the idle task, so it must never block. May be NULL. */
+    int (*idle_hook)(void);
+
+    /* Static schedule for the cyclic executive (see cyclic.h), or NULL
+     * for priorities alone */
+    const struct cyclic_table *cyclic;
 };
 
 extern struct kparam def_kparam;
@@ -74,6 +163,10 @@ void kern_handle_irq(struct kern *k, struct task_desc *active);
 /* Handle an undefined instruction */
 int kern_handle_undef(struct kern *k, struct task_desc *active);
 
+/* Destroy a task wherever it's blocked, unless it's part of a long
+ * copy. The caller checks that first (see ipc_copy_busy). */
+void kern_destroy(struct kern *k, struct task_desc *victim);
+
 /* Reset hardware state before returning to RedBoot. */
 void kern_cleanup(struct kern *kern);
 
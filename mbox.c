@@ -0,0 +1,163 @@
+/*******************************************************************************
+    Copyright 2014 Matthew Thiffault
+
+    This file is part of HeatheRTOS.
+
+    HeatheRTOS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    HeatheRTOS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with HeatheRTOS.  If not, see <http://www.gnu.org/licenses/>.
+
+*******************************************************************************/
+
+#include "config.h"
+#include "xbool.h"
+#include "xint.h"
+#include "xdef.h"
+#include "static_assert.h"
+#include "u_tid.h"
+#include "task.h"
+#include "event.h"
+#include "kern.h"
+#include "mbox.h"
+
+#include "xassert.h"
+#include "xmemcpy.h"
+#include "section.h"
+
+/* Each queue item is the length followed by the message */
+#define MBOX_ITEM_SIZE(msg_max) \
+    ((sizeof (int) + (msg_max) + sizeof (int) - 1) & ~(sizeof (int) - 1))
+
+static void mbox_deliver(struct task_desc *td, const void *msg, int len);
+
+COLD void
+mbox_init(struct kern *kern)
+{
+    int i;
+    kern->mbox.count = 0;
+    for (i = 0; i < MBOX_MAX; i++)
+        taskq_init(&kern->mbox.boxes[i].fetchers);
+}
+
+int
+mbox_create(struct kern *kern, void *mem, int size, int msg_max, int policy)
+{
+    struct mbox *mb;
+    int item_size;
+
+    if (mem == NULL
+        || ((uintptr_t)mem & (sizeof (int) - 1)) != 0
+        || msg_max <= 0
+        || msg_max > MBOX_MSG_MAX
+        || (policy != MBOX_REJECT && policy != MBOX_OVERWRITE))
+        return -1;
+
+    item_size = MBOX_ITEM_SIZE(msg_max);
+    if (size < item_size)
+        return -2;
+    if (kern->mbox.count == MBOX_MAX)
+        return -3;
+
+    mb = &kern->mbox.boxes[kern->mbox.count];
+    q_init(&mb->q, mem, item_size, size);
+    mb->msg_max = msg_max;
+    mb->policy  = policy;
+    return kern->mbox.count++;
+}
+
+HOT int
+mbox_post(struct kern *kern, int id, const void *msg, int len)
+{
+    struct mbox *mb;
+    struct task_desc *td;
+    int *item, rc = 0;
+
+    if (id < 0 || id >= kern->mbox.count)
+        return -1;
+    mb = &kern->mbox.boxes[id];
+    if (len < 0 || len > mb->msg_max)
+        return -2;
+
+    /* Somebody is already waiting: skip the queue */
+    td = task_dequeue(kern, &mb->fetchers);
+    if (td != NULL) {
+        mbox_deliver(td, msg, len);
+        task_ready(kern, td);
+        return 0;
+    }
+
+    item = q_push(&mb->q);
+    if (item == NULL) {
+        if (mb->policy == MBOX_REJECT)
+            return -3;
+        q_pop(&mb->q);
+        item = q_push(&mb->q);
+        rc   = 1;
+    }
+    item[0] = len;
+    memcpy(&item[1], msg, len);
+    return rc;
+}
+
+HOT void
+mbox_fetch(struct kern *kern, struct task_desc *active)
+{
+    struct mbox *mb;
+    int *item;
+    int id = (int)active->regs->r0;
+
+    if (id < 0 || id >= kern->mbox.count) {
+        active->regs->r0 = -1;
+        task_ready(kern, active);
+        return;
+    }
+    if ((int)active->regs->r2 < 0) {
+        active->regs->r0 = -2;
+        task_ready(kern, active);
+        return;
+    }
+
+    mb   = &kern->mbox.boxes[id];
+    item = q_front(&mb->q);
+    if (item == NULL) {
+        /* Wait for a Post(); it will find the buffer in r1/r2 */
+        TASK_SET_STATE(kern, active, TASK_STATE_FETCH_BLOCKED);
+        task_enqueue(kern, active, &mb->fetchers);
+        return;
+    }
+
+    mbox_deliver(active, &item[1], item[0]);
+    q_pop(&mb->q);
+    task_ready(kern, active);
+}
+
+/* Copy a message to a fetching task's buffer, truncated if need be,
+   and return its full length */
+static HOT void
+mbox_deliver(struct task_desc *td, const void *msg, int len)
+{
+    int n = len < (int)td->regs->r2 ? len : (int)td->regs->r2;
+    memcpy((void*)td->regs->r1, msg, n);
+    td->regs->r0 = len;
+}
+
+void
+mbox_forget(struct kern *kern, struct task_desc *td)
+{
+    int i;
+    assert(TASK_STATE(kern, td) == TASK_STATE_FETCH_BLOCKED);
+    for (i = 0; i < kern->mbox.count; i++) {
+        if (task_unlink(kern, td, &kern->mbox.boxes[i].fetchers))
+            return;
+    }
+    assert(false);
+}
@@ -0,0 +1,65 @@
+/*******************************************************************************
+    Copyright 2014 Matthew Thiffault
+
+    This file is part of HeatheRTOS.
+
+    HeatheRTOS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    HeatheRTOS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with HeatheRTOS.  If not, see <http://www.gnu.org/licenses/>.
+
+*******************************************************************************/
+
+#ifndef MBOX_H
+#define MBOX_H
+
+#include "xbool.h"
+#include "xint.h"
+#include "config.h"
+#include "task.h"
+#include "queue.h"
+#include "mbox_flags.h"
+
+/*
+ * Kernel mailboxes. A mailbox is a bounded queue of messages in memory
+ * given by its creator, each up to a fixed size. Post() copies a
+ * message in and never blocks; Fetch() copies the oldest one out,
+ * blocking while there are none. A message posted while a task is
+ * waiting in Fetch() goes straight to that task's buffer. Mailboxes
+ * are never destroyed.
+ */
+
+struct kern;
+
+struct mbox {
+    struct queue      q;        /* of MBOX_ITEM_SIZE items */
+    int               msg_max;  /* largest message */
+    int               policy;   /* MBOX_REJECT or MBOX_OVERWRITE */
+    struct task_queue fetchers; /* in TASK_STATE_FETCH_BLOCKED */
+};
+
+struct mboxes {
+    int         count;          /* created so far */
+    struct mbox boxes[MBOX_MAX];
+};
+
+/* Initialize mailbox state */
+void mbox_init(struct kern *kern);
+
+/* MboxCreate(), Post() and Fetch() for the active task */
+int  mbox_create(struct kern *kern, void *mem, int size, int msg_max, int policy);
+int  mbox_post(struct kern *kern, int id, const void *msg, int len);
+void mbox_fetch(struct kern *kern, struct task_desc *active);
+
+/* Take a task out of Fetch(), on Destroy() */
+void mbox_forget(struct kern *kern, struct task_desc *td);
+
+#endif
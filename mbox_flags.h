@@ -0,0 +1,32 @@
+/*******************************************************************************
+    Copyright 2014 Matthew Thiffault
+
+    This file is part of HeatheRTOS.
+
+    HeatheRTOS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    HeatheRTOS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with HeatheRTOS.  If not, see <http://www.gnu.org/licenses/>.
+
+*******************************************************************************/
+
+#ifndef MBOX_FLAGS_H
+#define MBOX_FLAGS_H
+
+/* Overflow policies for MboxCreate(). Shared by the kernel and tasks. */
+
+/* Post() to a full mailbox fails, and the message is lost */
+#define MBOX_REJECT     0
+
+/* Post() to a full mailbox drops the oldest message to make room */
+#define MBOX_OVERWRITE  1
+
+#endif
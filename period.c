@@ -0,0 +1,148 @@
+/*******************************************************************************
+    Copyright 2014 Matthew Thiffault
+
+    This file is part of HeatheRTOS.
+
+    HeatheRTOS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    HeatheRTOS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with HeatheRTOS.  If not, see <http://www.gnu.org/licenses/>.
+
+*******************************************************************************/
+
+#include "config.h"
+#include "xbool.h"
+#include "xint.h"
+#include "xdef.h"
+#include "static_assert.h"
+#include "u_tid.h"
+#include "task.h"
+#include "event.h"
+#include "kern.h"
+#include "period.h"
+
+#include "xassert.h"
+#include "section.h"
+#include "timer.h"
+#include "ktimer.h"
+
+COLD void
+period_init(struct kern *kern)
+{
+    int i;
+    kern->period.waiting      = 0;
+    kern->period.next_release = 0;
+    for (i = 0; i < MAX_TASKS; i++)
+        period_reset(kern, TASK_IX2PTR(kern, i));
+}
+
+void
+period_reset(struct kern *kern, struct task_desc *td)
+{
+    struct task_period *p = &kern->period.tasks[TASK_PTR2IX(kern, td)];
+    p->period = 0;
+    p->next   = 0;
+}
+
+int
+period_set(
+    struct kern *kern,
+    struct task_desc *td,
+    unsigned int period_us,
+    unsigned int offset_us)
+{
+    struct task_period *p = &kern->period.tasks[TASK_PTR2IX(kern, td)];
+
+    if (period_us > DBG_TMR_MAX_US || offset_us > DBG_TMR_MAX_US)
+        return -1;
+
+    p->period = period_us * DBG_TMR_TICKS_PER_US;
+    p->next   = dbg_tmr_ticks() + offset_us * DBG_TMR_TICKS_PER_US;
+    return 0;
+}
+
+HOT void
+period_wait(struct kern *kern, struct task_desc *active)
+{
+    struct task_period *p = &kern->period.tasks[TASK_PTR2IX(kern, active)];
+    uint32_t now, missed;
+
+    if (p->period == 0) {
+        active->regs->r0 = -1;
+        task_ready(kern, active);
+        return;
+    }
+
+    now = dbg_tmr_ticks();
+    if ((int32_t)(now - p->next) < 0) {
+        /* In time: sleep until the release */
+        active->regs->r0 = 0;
+        TASK_SET_STATE(kern, active, TASK_STATE_PERIOD_BLOCKED);
+        if (kern->period.waiting++ == 0
+            || (int32_t)(p->next - kern->period.next_release) < 0)
+            kern->period.next_release = p->next;
+        return;
+    }
+
+    /* Late. Run now for the latest release, skipping any before it. */
+    missed  = (now - p->next) / p->period;
+    p->next += (missed + 1) * p->period;
+    active->regs->r0 = missed;
+    task_ready(kern, active);
+}
+
+void
+period_release(struct kern *kern, uint32_t now)
+{
+    int i, left;
+    uint32_t next = now;
+    bool first = true;
+
+    if (kern->period.waiting == 0
+        || (int32_t)(now - kern->period.next_release) < 0)
+        return;
+
+    left = kern->period.waiting;
+    for (i = 0; i < MAX_TASKS && left > 0; i++) {
+        struct task_desc *td = TASK_IX2PTR(kern, i);
+        struct task_period *p = &kern->period.tasks[i];
+        if (TASK_STATE(kern, td) != TASK_STATE_PERIOD_BLOCKED)
+            continue;
+        left--;
+        if ((int32_t)(now - p->next) >= 0) {
+            p->next += p->period;
+            kern->period.waiting--;
+            task_ready(kern, td);
+        } else if (first || (int32_t)(p->next - next) < 0) {
+            next  = p->next;
+            first = false;
+        }
+    }
+    kern->period.next_release = next;
+}
+
+HOT uint32_t
+period_next(struct kern *kern, uint32_t now)
+{
+    int32_t until;
+
+    if (kern->period.waiting == 0)
+        return KTIMER_NEVER;
+    until = kern->period.next_release - now;
+    return until < 1 ? 1 : (uint32_t)until;
+}
+
+void
+period_forget(struct kern *kern, struct task_desc *td)
+{
+    assert(TASK_STATE(kern, td) == TASK_STATE_PERIOD_BLOCKED);
+    kern->period.waiting--;
+}
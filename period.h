@@ -0,0 +1,78 @@
+/*******************************************************************************
+    Copyright 2014 Matthew Thiffault
+
+    This file is part of HeatheRTOS.
+
+    HeatheRTOS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    HeatheRTOS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with HeatheRTOS.  If not, see <http://www.gnu.org/licenses/>.
+
+*******************************************************************************/
+
+#ifndef PERIOD_H
+#define PERIOD_H
+
+#include "xbool.h"
+#include "xint.h"
+#include "config.h"
+
+/*
+ * Periodic task releases. A task with a period blocks in WaitPeriod()
+ * until its next release time, and the kernel timer readies it then,
+ * with no clock server involved. Releases are at fixed times from the
+ * first one, so lateness never accumulates.
+ *
+ * Times are in debug timer ticks (DBG_TMR_HZ).
+ */
+
+struct kern;
+struct task_desc;
+
+struct task_period {
+    uint32_t period; /* 0 for none */
+    uint32_t next;   /* next release */
+};
+
+struct periods {
+    int                waiting;      /* tasks in TASK_STATE_PERIOD_BLOCKED */
+    uint32_t           next_release; /* earliest next of those tasks */
+    struct task_period tasks[MAX_TASKS];
+};
+
+/* Initialize period state */
+void period_init(struct kern *kern);
+
+/* Remove any period from a new task */
+void period_reset(struct kern *kern, struct task_desc *td);
+
+/* Give a task a period, its first release offset_us from now.
+ * A period of zero removes it. Returns 0, or -1 if out of range. */
+int period_set(
+    struct kern *kern,
+    struct task_desc *td,
+    unsigned int period_us,
+    unsigned int offset_us);
+
+/* WaitPeriod() for the active task: block until its next release,
+ * or return the number of releases missed at once if that is past */
+void period_wait(struct kern *kern, struct task_desc *active);
+
+/* Ready waiting tasks whose release times have come */
+void period_release(struct kern *kern, uint32_t now);
+
+/* Ticks until the next release of a waiting task, or KTIMER_NEVER */
+uint32_t period_next(struct kern *kern, uint32_t now);
+
+/* Take a waiting task out of the count, on Destroy() */
+void period_forget(struct kern *kern, struct task_desc *td);
+
+#endif
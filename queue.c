@@ -70,6 +70,40 @@ q_enqueue(struct queue *q, const void *buf_in)
     return 0;
 }
 
+/* Add an item in place */
+void*
+q_push(struct queue *q)
+{
+    void *item;
+    if (q->size == q->cap)
+        return NULL;
+
+    item     = q->mem + q->wr;
+    q->wr   += q->eltsize;
+    q->wr   %= q->cap;
+    q->size += q->eltsize;
+    q->count++;
+    return item;
+}
+
+/* Returns the first item in place */
+void*
+q_front(struct queue *q)
+{
+    return q->size == 0 ? NULL : q->mem + q->rd;
+}
+
+/* Remove the first item without copying it out */
+void
+q_pop(struct queue *q)
+{
+    assert(q->size > 0);
+    q->rd   += q->eltsize;
+    q->rd   %= q->cap;
+    q->size -= q->eltsize;
+    q->count--;
+}
+
 /* Returns how many items are in a queue */
 int
 q_size(struct queue *q)
@@ -39,6 +39,13 @@ void q_init(struct queue *q, void *mem, int eltsize, int maxsize);
 bool q_dequeue(struct queue *q, void *buf_out);
 /* Add an item to the queue */
 int  q_enqueue(struct queue *q, const void *buf_in);
+/* Add an item in place: returns the new last item for the caller to
+ * fill in, or NULL if the queue is full */
+void *q_push(struct queue *q);
+/* Returns the first item in place, or NULL if the queue is empty */
+void *q_front(struct queue *q);
+/* Remove the first item without copying it out. Must not be empty. */
+void q_pop(struct queue *q);
 /* Returns how many items are in a queue */
 int  q_size(struct queue *q);
 
@@ -0,0 +1,39 @@
+/*******************************************************************************
+    Copyright 2014 Matthew Thiffault
+
+    This file is part of HeatheRTOS.
+
+    HeatheRTOS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    HeatheRTOS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with HeatheRTOS.  If not, see <http://www.gnu.org/licenses/>.
+
+*******************************************************************************/
+
+#ifndef SECTION_H
+#define SECTION_H
+
+/* Code placement. HOT functions are grouped at the start of on-chip
+ * RAM; COLD functions run from DDR (see the linker script). Use HOT
+ * only for code on the scheduling, IPC and interrupt paths, since
+ * on-chip RAM is small. */
+#define HOT  __attribute__((section(".text.hot")))
+#define COLD __attribute__((cold, section(".text.cold")))
+
+/* Data placement. Cortex-A8 L1 and L2 lines are 64 bytes. */
+#define CACHE_LINE    64
+#define CACHE_ALIGNED __attribute__((aligned(CACHE_LINE)))
+
+/* Zeroed data in DDR rather than on-chip RAM, for large tables off the
+ * fast paths. Nothing clears it at startup: owners must. */
+#define DDR_BSS __attribute__((section(".bss.ddr")))
+
+#endif
@@ -0,0 +1,71 @@
+/*******************************************************************************
+    Copyright 2014 Matthew Thiffault
+
+    This file is part of HeatheRTOS.
+
+    HeatheRTOS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    HeatheRTOS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with HeatheRTOS.  If not, see <http://www.gnu.org/licenses/>.
+
+*******************************************************************************/
+
+#include "xint.h"
+#include "xdef.h"
+#include "seqlock.h"
+
+#include "xmemcpy.h"
+
+void
+seqlock_init(
+    struct seqlock *s,
+    void *buf0,
+    void *buf1,
+    size_t size,
+    const void *val)
+{
+    s->seq     = 0;
+    s->copy[0] = buf0;
+    s->copy[1] = buf1;
+    s->size    = size;
+    memcpy(buf0, val, size);
+    memcpy(buf1, val, size);
+}
+
+void
+seqlock_write(struct seqlock *s, const void *val)
+{
+    uint32_t seq = s->seq;
+
+    /* Readers move to copy 1 while copy 0 is written, then back */
+    s->seq = seq + 1;
+    barrier();
+    memcpy(s->copy[0], val, s->size);
+    barrier();
+    s->seq = seq + 2;
+    barrier();
+    memcpy(s->copy[1], val, s->size);
+    barrier();
+}
+
+uint32_t
+seqlock_read(const struct seqlock *s, void *out)
+{
+    uint32_t seq;
+
+    do {
+        seq = s->seq;
+        barrier();
+        memcpy(out, s->copy[seq & 1], s->size);
+        barrier();
+    } while (s->seq != seq);
+    return seq & ~1u;
+}
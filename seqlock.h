@@ -0,0 +1,65 @@
+/*******************************************************************************
+    Copyright 2014 Matthew Thiffault
+
+    This file is part of HeatheRTOS.
+
+    HeatheRTOS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    HeatheRTOS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with HeatheRTOS.  If not, see <http://www.gnu.org/licenses/>.
+
+*******************************************************************************/
+
+#ifndef SEQLOCK_H
+#define SEQLOCK_H
+
+#include "xint.h"
+#include "xdef.h"
+#include "section.h"
+
+/*
+ * Publication of a shared value to any number of readers, without
+ * system calls or a server task in between.
+ *
+ * One writer task publishes snapshots of a fixed size object; readers
+ * take consistent copies. There is only one core, so a reader can't
+ * wait for a writer it has preempted: the value is kept twice, and
+ * the sequence number tells readers which copy is stable. The writer
+ * updates the other copy first, then flips readers to it and updates
+ * the first. A reader retries only if it was itself preempted by a
+ * publish while copying.
+ *
+ * Several writers must take turns some other way.
+ */
+
+struct seqlock {
+    volatile uint32_t seq CACHE_ALIGNED; /* low bit: copy to read */
+    char  *copy[2];
+    size_t size;
+};
+
+/* Set up a seqlock publishing size bytes, kept in two buffers of that
+ * size, with initial contents val. */
+void seqlock_init(
+    struct seqlock *s,
+    void *buf0,
+    void *buf1,
+    size_t size,
+    const void *val);
+
+/* Publish a new value */
+void seqlock_write(struct seqlock *s, const void *val);
+
+/* Copy out the latest value. Returns its version, which goes up by
+ * two with each publish. */
+uint32_t seqlock_read(const struct seqlock *s, void *out);
+
+#endif
@@ -21,7 +21,8 @@
 #ifndef SYSCALL_H
 #define SYSCALL_H
 
-/* Syscall Numbers */
+/* Syscall Numbers. These must fit in 8 bits, the most a Thumb SVC
+   instruction can carry. */
 #define SYSCALL_CREATE          0x0
 #define SYSCALL_MYTID           0x1
 #define SYSCALL_MYPARENTTID     0x2
@@ -36,5 +37,25 @@
 #define SYSCALL_AWAITEVENT      0xb
 #define SYSCALL_SHUTDOWN        0xc
 #define SYSCALL_PANIC           0xd
+#define SYSCALL_REGISTERFIQ     0xe
+#define SYSCALL_SETEVENTLIMIT   0xf
+#define SYSCALL_EVENTSTATS      0x10
+#define SYSCALL_BATCH           0x11
+#define SYSCALL_REPLYMULTI      0x12
+#define SYSCALL_CREATEARG       0x13
+#define SYSCALL_SETBUDGET       0x14
+#define SYSCALL_BUDGETSTATS     0x15
+#define SYSCALL_PARK            0x16
+#define SYSCALL_UNPARK          0x17
+#define SYSCALL_SETPERIOD       0x18
+#define SYSCALL_WAITPERIOD      0x19
+#define SYSCALL_CYCLICWAIT      0x1a
+#define SYSCALL_MBOXCREATE      0x1b
+#define SYSCALL_POST            0x1c
+#define SYSCALL_FETCH           0x1d
+#define SYSCALL_SENDASYNC       0x1e
+#define SYSCALL_AWAITREPLY      0x1f
+
+#define SYSCALL_COUNT           0x20 /* One past the highest number */
 
 #endif
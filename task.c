@@ -28,14 +28,17 @@
 #include "xbool.h"
 #include "xassert.h"
 #include "bithack.h"
+#include "section.h"
+#include "xmemcpy.h"
 
 #include "event.h"
 #include "kern.h"
 #include "cpumode.h"
 #include "u_syscall.h"
+#include "link.h"
 
 /* Get a pointer to the task descriptor with the specified TID */
-int
+HOT int
 get_task(struct kern *kern, tid_t tid, struct task_desc **td_out)
 {
     struct task_desc *td;
@@ -46,7 +49,7 @@ get_task(struct kern *kern, tid_t tid, struct task_desc **td_out)
         return GET_TASK_IMPOSSIBLE_TID;
 
     td = &kern->tasks[ix];
-    if (TASK_STATE(td) == TASK_STATE_FREE || td->tid_seq != (tid >> 8))
+    if (TASK_STATE(kern, td) == TASK_STATE_FREE || td->tid_seq != (tid >> 8))
         return GET_TASK_NO_SUCH_TASK;
 
     *td_out = td;
@@ -59,35 +62,78 @@ task_create(
     struct kern *kern,
     uint8_t parent_ix,
     int priority,
-    void (*task_entry)(void))
+    void (*task_entry)(void),
+    const void *arg,
+    size_t argsize)
 {
     struct task_desc *td;
     uint8_t ix;
-    void *stack;
+    char *stack;
+    bool ocmc;
 
+    ocmc      = (priority & CREATE_OCMC_STACK) != 0;
+    priority &= ~CREATE_OCMC_STACK;
     if (priority < 0 || priority >= N_PRIORITIES)
         return -1; /* invalid priority */
 
+    if (argsize > TASK_ARG_MAX)
+        return -3; /* argument too large */
+
+    if (ocmc && kern->ocmc_free == 0)
+        return -4; /* no more OCMC stacks */
+
     td = task_dequeue(kern, &kern->free_tasks);
     if (td == NULL)
         return -2; /* no more task descriptors */
 
-    assert((td->state_prio & TASK_STATE_MASK) == TASK_STATE_FREE);
+    assert(TASK_STATE(kern, td) == TASK_STATE_FREE);
 
     /* Guaranteed to succeed from this point: initialize task. */
     ix             = TASK_PTR2IX(kern, td);
     td->parent_ix  = parent_ix;
-    TASK_SET_PRIO(td, priority); /* task_ready() will set state */
+    TASK_SET_PRIO(kern, td, priority); /* task_ready() will set state */
+
+    if (ocmc) {
+        int slot = ctz32(kern->ocmc_free);
+        kern->ocmc_free &= ~(1u << slot);
+        td->ocmc_stack = slot;
+        stack = (char*)OcmcStacksEnd - slot * OCMC_STACK_SIZE;
+    } else {
+        td->ocmc_stack = -1;
+        stack = kern->user_stacks_bottom - ix * kern->user_stack_size;
+    }
+
+    /* Registers are saved at the very top of the stack, with room for
+     * the VFP state below them. The stack proper starts underneath. */
+    td->regs       = (struct task_regs*)stack - 1;
+    stack         -= sizeof (struct task_regs) + sizeof (struct task_fpu_regs);
+
+    /* The argument goes at the top of the stack proper, 8-byte aligned */
+    if (argsize > 0) {
+        stack -= (argsize + 7) & ~7;
+        memcpy(stack, arg, argsize);
+    }
 
-    stack          = kern->user_stacks_bottom - ix * kern->user_stack_size;
-    td->regs       = (struct task_regs*)stack - 1; /* leave room for regs */
     td->regs->spsr = cpumode_bits(MODE_USR);       /* interrupts enabled */
     td->regs->sp   = (uint32_t)stack;
     td->regs->lr   = (uint32_t)&Exit; /* call Exit on return of task_entry */
-    td->regs->pc   = (uint32_t)task_entry;
+    td->regs->pc   = (uint32_t)task_entry & ~1;
+    if ((uint32_t)task_entry & 1)
+        td->regs->spsr |= PSR_THUMB; /* interworking address of Thumb code */
+    td->regs->r0   = argsize > 0 ? (uint32_t)stack : 0;
+    td->regs->r1   = argsize;
     td->cleanup    = NULL;
     td->irq        = (int8_t)-1;
+    td->evt_pending = 0;
     td->time       = 0;
+    td->fpu_ctx_on_stack = 0;
+    td->fpu_regs   = NULL;
+    td->unparked   = 0;
+    td->doomed     = 0;
+    td->txn_head   = TXN_IX_NULL;
+    td->txn_tail   = TXN_IX_NULL;
+    budget_reset(kern, td);
+    period_reset(kern, td);
 
     taskq_init(&td->senders);
 
@@ -96,20 +142,36 @@ task_create(
 }
 
 /* Put a task on the appropriate kernel ready queue */
-void
+HOT void
 task_ready(struct kern *kern, struct task_desc *td)
 {
-    int prio = TASK_PRIO(td);
-    TASK_SET_STATE(td, TASK_STATE_READY);
+    int prio = TASK_PRIO(kern, td);
+    TASK_SET_STATE(kern, td, TASK_STATE_READY);
     task_enqueue(kern, td, &kern->rdy_queues[prio]);
     kern->rdy_queue_ne |= 1 << prio;
     kern->rdy_count++;
 }
 
+/* Take a task back off the ready queue */
+void
+task_unready(struct kern *kern, struct task_desc *td)
+{
+    int prio = TASK_PRIO(kern, td);
+    struct task_queue *q = &kern->rdy_queues[prio];
+    bool found;
+
+    assert(TASK_STATE(kern, td) == TASK_STATE_READY);
+    found = task_unlink(kern, td, q);
+    assertv(found, found);
+    if (q->head_ix == TASK_IX_NULL)
+        kern->rdy_queue_ne &= ~(1 << prio);
+    kern->rdy_count--;
+}
+
 /* Pops the task with the highest priority from its
    ready queue */
 /* NB. lower numbers are higher priority! */
-struct task_desc*
+HOT struct task_desc*
 task_schedule(struct kern *kern)
 {
     int prio;
@@ -129,8 +191,8 @@ task_schedule(struct kern *kern)
     if (q->head_ix == TASK_IX_NULL)
         kern->rdy_queue_ne &= ~(1 << prio);
 
-    assert(TASK_STATE(td) == TASK_STATE_READY);
-    TASK_SET_STATE(td, TASK_STATE_ACTIVE);
+    assert(TASK_STATE(kern, td) == TASK_STATE_READY);
+    TASK_SET_STATE(kern, td, TASK_STATE_ACTIVE);
     kern->rdy_count--;
     return td;
 }
@@ -139,14 +201,26 @@ task_schedule(struct kern *kern)
 void
 task_free(struct kern *kern, struct task_desc *td)
 {
-    TASK_SET_STATE(td, TASK_STATE_FREE);
-    td->tid_seq++;
-    if (td->irq >= 0) {
+    if (kern->eventab.fiq_tid == TASK_TID(kern, td)) {
         int rc;
-        rc = evt_unregister(&kern->eventab, td->irq);
+        rc = evt_unregister_fiq(&kern->eventab);
         assertv(rc, rc == 0);
     }
+#ifdef HARD_FLOAT
+    if (kern->fp_ctx_holder == td)
+        kern->fp_ctx_holder = NULL;
+#endif
+    if (td->ocmc_stack >= 0)
+        kern->ocmc_free |= 1u << td->ocmc_stack;
+    TASK_SET_STATE(kern, td, TASK_STATE_FREE);
+    td->tid_seq++;
+    evt_unregister_all(&kern->eventab, &td->irq);
+#ifdef TASK_POOL
+    /* Hand this descriptor out next, while its stack is still warm */
+    task_push(kern, td, &kern->free_tasks);
+#else
     task_enqueue(kern, td, &kern->free_tasks);
+#endif
 }
 
 /* Initialize a task queue */
@@ -158,31 +232,66 @@ taskq_init(struct task_queue *q)
 }
 
 /* Enqueue a task */
-void
+HOT void
 task_enqueue(struct kern *kern, struct task_desc *td, struct task_queue *q)
 {
     uint8_t ix = TASK_PTR2IX(kern, td);
-    assert(td->next_ix == TASK_IX_NOTINQUEUE);
-    td->next_ix = TASK_IX_NULL;
+    assert(TASK_NEXT(kern, ix) == TASK_IX_NOTINQUEUE);
+    TASK_NEXT(kern, ix) = TASK_IX_NULL;
     if (q->head_ix == TASK_IX_NULL) {
         q->head_ix = ix;
         q->tail_ix = ix;
     } else {
-        TASK_IX2PTR(kern, q->tail_ix)->next_ix = ix;
+        TASK_NEXT(kern, q->tail_ix) = ix;
         q->tail_ix = ix;
     }
 }
 
+/* Push a task onto the front of a queue */
+void
+task_push(struct kern *kern, struct task_desc *td, struct task_queue *q)
+{
+    uint8_t ix = TASK_PTR2IX(kern, td);
+    assert(TASK_NEXT(kern, ix) == TASK_IX_NOTINQUEUE);
+    TASK_NEXT(kern, ix) = q->head_ix;
+    if (q->head_ix == TASK_IX_NULL)
+        q->tail_ix = ix;
+    q->head_ix = ix;
+}
+
 /* Dequeue a task */
-struct task_desc*
+HOT struct task_desc*
 task_dequeue(struct kern *kern, struct task_queue *q)
 {
-    struct task_desc *td;
-    if (q->head_ix == TASK_IX_NULL)
+    uint8_t ix = q->head_ix;
+    if (ix == TASK_IX_NULL)
         return NULL;
 
-    td = TASK_IX2PTR(kern, q->head_ix);
-    q->head_ix = td->next_ix;
-    td->next_ix = TASK_IX_NOTINQUEUE;
-    return td;
+    q->head_ix = TASK_NEXT(kern, ix);
+    TASK_NEXT(kern, ix) = TASK_IX_NOTINQUEUE;
+    return TASK_IX2PTR(kern, ix);
+}
+
+/* Remove a task from the middle of a queue */
+bool
+task_unlink(struct kern *kern, struct task_desc *td, struct task_queue *q)
+{
+    uint8_t ix = TASK_PTR2IX(kern, td);
+    uint8_t prev_ix = TASK_IX_NULL, cur_ix = q->head_ix;
+
+    while (cur_ix != TASK_IX_NULL && cur_ix != ix) {
+        prev_ix = cur_ix;
+        cur_ix  = TASK_NEXT(kern, cur_ix);
+    }
+    if (cur_ix == TASK_IX_NULL)
+        return false;
+
+    if (prev_ix == TASK_IX_NULL)
+        q->head_ix = TASK_NEXT(kern, ix);
+    else
+        TASK_NEXT(kern, prev_ix) = TASK_NEXT(kern, ix);
+    if (q->tail_ix == ix)
+        q->tail_ix = prev_ix;
+    TASK_NEXT(kern, ix) = TASK_IX_NOTINQUEUE;
+    return true;
 }
@@ -21,6 +21,7 @@
 #ifndef TASK_H
 #define TASK_H
 
+#include "xbool.h"
 #include "xint.h"
 #include "xdef.h"
 #include "static_assert.h"
@@ -44,15 +45,22 @@ struct task_fpu_regs;
 #define TASK_TID(kern, tdp)    \
     (((tdp)->tid_seq << TID_SEQ_OFFS) | TASK_PTR2IX(kern, tdp))
 
-/* Task descriptor stores state and priority in a single byte */
+/* State and priority share a byte, kept in kern->state_prio[] rather
+ * than the task descriptor (see struct kern) */
 #define TASK_STATE_MASK 0xf0
 #define TASK_PRIO_MASK  0x0f
-#define TASK_STATE(tdp) ((tdp)->state_prio & TASK_STATE_MASK)
-#define TASK_PRIO(tdp)  ((tdp)->state_prio & TASK_PRIO_MASK)
-#define TASK_SET_STATE(tdp, state) \
-    ((tdp)->state_prio = ((tdp)->state_prio & ~TASK_STATE_MASK) | (state))
-#define TASK_SET_PRIO(tdp, prio)   \
-    ((tdp)->state_prio = ((tdp)->state_prio & ~TASK_PRIO_MASK) | (prio))
+#define TASK_STATE_PRIO(kern, tdp) ((kern)->state_prio[TASK_PTR2IX(kern, tdp)])
+#define TASK_STATE(kern, tdp) (TASK_STATE_PRIO(kern, tdp) & TASK_STATE_MASK)
+#define TASK_PRIO(kern, tdp)  (TASK_STATE_PRIO(kern, tdp) & TASK_PRIO_MASK)
+#define TASK_SET_STATE(kern, tdp, state)            \
+    (TASK_STATE_PRIO(kern, tdp) =                   \
+        (TASK_STATE_PRIO(kern, tdp) & ~TASK_STATE_MASK) | (state))
+#define TASK_SET_PRIO(kern, tdp, prio)              \
+    (TASK_STATE_PRIO(kern, tdp) =                   \
+        (TASK_STATE_PRIO(kern, tdp) & ~TASK_PRIO_MASK) | (prio))
+
+/* Queue links are kept in kern->next_ix[] */
+#define TASK_NEXT(kern, ix) ((kern)->next_ix[(ix)])
 
 /* Task state constants */
 enum {
@@ -63,7 +71,14 @@ enum {
     TASK_STATE_SEND_BLOCKED    = 0x40, /* Blocked: Receive waiting for Send */
     TASK_STATE_RECEIVE_BLOCKED = 0x50, /* Blocked: Send waiting for Receive */
     TASK_STATE_REPLY_BLOCKED   = 0x60, /* Blocked: Send waiting for Reply */
-    TASK_STATE_EVENT_BLOCKED   = 0x70  /* Blocked: AwaitEvent */
+    TASK_STATE_EVENT_BLOCKED   = 0x70, /* Blocked: AwaitEvent */
+    TASK_STATE_COPY_BLOCKED    = 0x80, /* Blocked: long message copy */
+    TASK_STATE_THROTTLED       = 0x90, /* Out of CPU budget */
+    TASK_STATE_PARKED          = 0xa0, /* Blocked: Park */
+    TASK_STATE_PERIOD_BLOCKED  = 0xb0, /* Blocked: WaitPeriod */
+    TASK_STATE_CYCLIC_BLOCKED  = 0xc0, /* Blocked: CyclicWait */
+    TASK_STATE_FETCH_BLOCKED   = 0xd0, /* Blocked: Fetch */
+    TASK_STATE_TXN_BLOCKED     = 0xe0  /* Blocked: AwaitReply */
 };
 
 /* Singly-linked task queue */
@@ -73,46 +88,67 @@ struct task_queue {
 };
 STATIC_ASSERT(task_queue_size, sizeof (struct task_queue) == 2);
 
+/* Fields used on most kernel entries come first. Two descriptors share
+ * a cache line. */
 struct task_desc {
-    /* Points into the task's stack. The task's stack pointer is
-     * state + sizeof (task_regs). Context switch assumes this is
-     * the first member of struct task_desc. */
+    /* Points to the register save area at the top of the task's
+     * stack. It doesn't move while the task lives. Context switch
+     * assumes this is the first member of struct task_desc. */
     volatile struct task_regs *regs;
 
     /* Task info */
-    uint8_t state_prio; /* sssspppp : s state, p priority */
     uint8_t tid_seq;    /* high byte of tid */
     uint8_t parent_ix;  /* parent task descriptor index */
-    uint8_t next_ix;    /* next pointer task descriptor index */
     /* NB. no spsr         - use regs->spsr
      *     no return value - use regs->r0. */
 
     /* Send queue for this task */
     struct task_queue senders;
 
-    /* Registered cleanup function */
-    void (*cleanup)(void);
+    /* Number of this task's EVT_MSG events with messages waiting */
+    uint8_t evt_pending;
 
-    /* Registered event (IRQ number) */
+    /* Registered events: IRQ number at the head of the task's
+     * event list (see struct event), or -1 */
     int8_t irq;
 
-    /* Time spent in task. */
-    uint32_t time;
-
     /* Flag which is set to true if the task has a floating
      point context saved on it's stack. */
     uint8_t fpu_ctx_on_stack;
 
+    /* Slot in the OCMC stack pool, or -1 for the task's DDR stack */
+    int8_t ocmc_stack;
+
+    /* Time spent in task. */
+    uint32_t time;
+
     /* Points to FPU Context on stack, if not null. */
     volatile struct task_fpu_regs *fpu_regs;
+
+    /* Registered cleanup function */
+    void (*cleanup)(void);
+
+    /* Set by Unpark() while the task isn't parked, consumed by Park() */
+    uint8_t unparked;
+
+    /* SendAsync() transactions waiting for this task to Receive() them,
+     * as indices into kern->txns, or TXN_IX_NULL */
+    uint8_t txn_head;
+    uint8_t txn_tail;
+
+    /* Set by Destroy() while the task is part of a long copy. The copy
+     * carries on a chunk at a time, and the task goes when it's done. */
+    uint8_t doomed;
+
+    uint8_t reserved[4];
 };
 STATIC_ASSERT(task_desc_size, sizeof (struct task_desc) == 32);
 
 
-/* Context switch assumes this memory layout */
+/* Register save area, at a fixed place at the top of each task's
+ * stack. Context switch assumes this memory layout: it is filled by
+ * STM (user registers) followed by SRS, so pc and spsr come last. */
 struct task_regs {
-    uint32_t spsr;
-    uint32_t pc;
     uint32_t r0;
     uint32_t r1;
     uint32_t r2;
@@ -128,26 +164,28 @@ struct task_regs {
     uint32_t r12;
     uint32_t sp;
     uint32_t lr;
+    uint32_t pc;
+    uint32_t spsr;
 };
 
 /* Check memory layout is as assumed by context switch */
-STATIC_ASSERT(task_regs_spsr, offsetof (struct task_regs, spsr) == 0x0);
-STATIC_ASSERT(task_regs_pc,   offsetof (struct task_regs, pc)   == 0x4);
-STATIC_ASSERT(task_regs_r0,   offsetof (struct task_regs, r0)   == 0x8);
-STATIC_ASSERT(task_regs_r1,   offsetof (struct task_regs, r1)   == 0xc);
-STATIC_ASSERT(task_regs_r2,   offsetof (struct task_regs, r2)   == 0x10);
-STATIC_ASSERT(task_regs_r3,   offsetof (struct task_regs, r3)   == 0x14);
-STATIC_ASSERT(task_regs_r4,   offsetof (struct task_regs, r4)   == 0x18);
-STATIC_ASSERT(task_regs_r5,   offsetof (struct task_regs, r5)   == 0x1c);
-STATIC_ASSERT(task_regs_r6,   offsetof (struct task_regs, r6)   == 0x20);
-STATIC_ASSERT(task_regs_r7,   offsetof (struct task_regs, r7)   == 0x24);
-STATIC_ASSERT(task_regs_r8,   offsetof (struct task_regs, r8)   == 0x28);
-STATIC_ASSERT(task_regs_r9,   offsetof (struct task_regs, r9)   == 0x2c);
-STATIC_ASSERT(task_regs_r10,  offsetof (struct task_regs, r10)  == 0x30);
-STATIC_ASSERT(task_regs_r11,  offsetof (struct task_regs, r11)  == 0x34);
-STATIC_ASSERT(task_regs_r12,  offsetof (struct task_regs, r12)  == 0x38);
-STATIC_ASSERT(task_regs_sp,   offsetof (struct task_regs, sp)   == 0x3c);
-STATIC_ASSERT(task_regs_lr,   offsetof (struct task_regs, lr)   == 0x40);
+STATIC_ASSERT(task_regs_r0,   offsetof (struct task_regs, r0)   == 0x0);
+STATIC_ASSERT(task_regs_r1,   offsetof (struct task_regs, r1)   == 0x4);
+STATIC_ASSERT(task_regs_r2,   offsetof (struct task_regs, r2)   == 0x8);
+STATIC_ASSERT(task_regs_r3,   offsetof (struct task_regs, r3)   == 0xc);
+STATIC_ASSERT(task_regs_r4,   offsetof (struct task_regs, r4)   == 0x10);
+STATIC_ASSERT(task_regs_r5,   offsetof (struct task_regs, r5)   == 0x14);
+STATIC_ASSERT(task_regs_r6,   offsetof (struct task_regs, r6)   == 0x18);
+STATIC_ASSERT(task_regs_r7,   offsetof (struct task_regs, r7)   == 0x1c);
+STATIC_ASSERT(task_regs_r8,   offsetof (struct task_regs, r8)   == 0x20);
+STATIC_ASSERT(task_regs_r9,   offsetof (struct task_regs, r9)   == 0x24);
+STATIC_ASSERT(task_regs_r10,  offsetof (struct task_regs, r10)  == 0x28);
+STATIC_ASSERT(task_regs_r11,  offsetof (struct task_regs, r11)  == 0x2c);
+STATIC_ASSERT(task_regs_r12,  offsetof (struct task_regs, r12)  == 0x30);
+STATIC_ASSERT(task_regs_sp,   offsetof (struct task_regs, sp)   == 0x34);
+STATIC_ASSERT(task_regs_lr,   offsetof (struct task_regs, lr)   == 0x38);
+STATIC_ASSERT(task_regs_pc,   offsetof (struct task_regs, pc)   == 0x3c);
+STATIC_ASSERT(task_regs_spsr, offsetof (struct task_regs, spsr) == 0x40);
 STATIC_ASSERT(task_regs_size, sizeof   (struct task_regs)       == 0x44);
 
 /* Context switch assumes this memory layout */
@@ -256,6 +294,10 @@ STATIC_ASSERT(task_fpu_regs_d31,   offsetof (struct task_fpu_regs, D31_low) == 0
 
 STATIC_ASSERT(task_fpu_regs_size, sizeof   (struct task_fpu_regs)       == 0x104);
 
+/* The stack proper starts below both save areas, and must be aligned */
+STATIC_ASSERT(task_save_align,
+    (sizeof (struct task_regs) + sizeof (struct task_fpu_regs)) % 8 == 0);
+
 /* Find a task by its TID. Returns one of the following error codes. */
 int get_task(struct kern *k, tid_t tid, struct task_desc **td_out);
 
@@ -267,19 +309,29 @@ enum {
 
 /* Create a new task. Returns the TID of the newly created task,
  * or an error code: -1 for invalid priority, -2 if out of task
- * descriptors.
+ * descriptors, -3 if argsize is over TASK_ARG_MAX, -4 if the task
+ * wants an OCMC stack and none is free.
  *
  * Valid priorities are 0 <= p < N_PRIORITIES, where lower numbers
- * indicate higher priority. */
+ * indicate higher priority, optionally or'ed with CREATE_OCMC_STACK.
+ *
+ * argsize bytes at arg are copied to the top of the new task's stack,
+ * and task_entry is called with the copy's address and argsize as its
+ * arguments (NULL and 0 if argsize is 0). */
 tid_t task_create(
     struct kern *k,
     uint8_t parent_ix,
     int priority,
-    void (*task_entry)(void));
+    void (*task_entry)(void),
+    const void *arg,
+    size_t argsize);
 
 /* Add a task to the ready queue for its priority. */
 void task_ready(struct kern *k, struct task_desc *td);
 
+/* Take a ready task back off its ready queue. */
+void task_unready(struct kern *k, struct task_desc *td);
+
 /* Schedule the highest priority ready task.
  * The scheduled task is marked active and removed from ready queue.
  * If no tasks are ready, returns NULL. */
@@ -296,7 +348,15 @@ void task_free(struct kern *k, struct task_desc *td);
  * Do not enqueue tasks that are still part of another queue! */
 void task_enqueue(struct kern*, struct task_desc*, struct task_queue*);
 
+/* Push a task onto the front of a task queue. Same caveats as
+ * task_enqueue(). */
+void task_push(struct kern*, struct task_desc*, struct task_queue*);
+
 /* Attempt to dequeue a task from a task queue. Returns NULL if empty. */
 struct task_desc *task_dequeue(struct kern*, struct task_queue*);
 
+/* Remove a task from anywhere in a task queue. Linear in the queue's
+ * length. Returns false if the task wasn't on the queue. */
+bool task_unlink(struct kern*, struct task_desc*, struct task_queue*);
+
 #endif
@@ -0,0 +1,190 @@
+#undef NOASSERT
+
+#include "test/test_batch.h"
+
+#include "config.h"
+#include "xbool.h"
+#include "xint.h"
+#include "xdef.h"
+#include "static_assert.h"
+#include "u_tid.h"
+#include "task.h"
+#include "event.h"
+#include "kern.h"
+
+#include "xassert.h"
+#include "xstring.h"
+#include "u_syscall.h"
+#include "batch.h"
+
+#include "xarg.h"
+#include "bwio.h"
+
+#define TEST(init) test_batch_kern(#init, &init)
+
+static void test_batch_kern(const char *name, void (*)(void));
+
+static void test_batch_replies(void);
+static void test_batch_errors(void);
+static void test_batch_receive_last(void);
+static void test_reply_multi(void);
+
+void
+test_batch_all(void)
+{
+    TEST(test_batch_replies);
+    TEST(test_batch_errors);
+    TEST(test_batch_receive_last);
+    TEST(test_reply_multi);
+}
+
+static void
+test_batch_kern(const char *name, void (*init)(void))
+{
+    struct kparam kp = { .init = init, .init_prio = 8, .show_top = false };
+    bwprintf("%s...", name);
+    kern_main(&kp);
+    bwputstr("ok\n\r");
+}
+
+static void
+test_batch_replies_sender(void)
+{
+    char reply[8];
+    int  replylen;
+    replylen = Send(MyParentTid(), "hi", 3, reply, sizeof (reply));
+    assert(replylen == 5);
+    assert(strcmp(reply, "done") == 0);
+}
+
+static void
+test_batch_replies(void)
+{
+    struct batch_op ops[3];
+    char msg[4], rply[5] = "done";
+    int i, rc, tid;
+
+    for (i = 0; i < 3; i++) {
+        Create(9, &test_batch_replies_sender);
+        rc = Receive(&tid, msg, sizeof (msg));
+        assert(rc == 3);
+        ops[i].op  = BATCH_REPLY;
+        ops[i].tid = tid;
+        ops[i].buf = rply;
+        ops[i].len = sizeof (rply);
+        ops[i].rc  = -42;
+    }
+
+    /* One trap replies to all three */
+    rc = Batch(ops, 3);
+    assert(rc == 0);
+    for (i = 0; i < 3; i++)
+        assert(ops[i].rc == 0);
+}
+
+static void
+test_batch_errors(void)
+{
+    struct batch_op ops[4];
+    int rc;
+
+    ops[0].op  = 42;
+    ops[1].op  = BATCH_RECEIVE;
+    ops[1].tid = -42;
+    ops[2].op  = BATCH_REPLY;
+    ops[2].tid = 1 << 16;
+    ops[2].buf = NULL;
+    ops[2].len = 0;
+    ops[3].op  = BATCH_REPLY;
+    ops[3].tid = MyTid();
+    ops[3].buf = NULL;
+    ops[3].len = IPC_COPY_CHUNK + 1;
+    rc = Batch(ops, 4);
+    assert(rc == 0);
+    assert(ops[0].rc == BATCH_BAD_OP);
+    assert(ops[1].rc == BATCH_NOT_LAST);
+    assert(ops[1].tid == -42);
+    assert(ops[2].rc == -1);
+    assert(ops[3].rc == BATCH_TOO_LONG);
+
+    rc = Batch(ops, -1);
+    assert(rc == -1);
+}
+
+static void
+test_batch_receive_last_sender(void)
+{
+    Send(MyParentTid(), "foobar baz", 11, NULL, 0);
+}
+
+static void
+test_batch_receive_last(void)
+{
+    struct batch_op ops[2];
+    char msg[16];
+    int rc, child_tid, first_tid;
+
+    /* Reply to the first sender and wait for the second in one trap */
+    child_tid = Create(0, &test_batch_receive_last_sender);
+    rc = Receive(&first_tid, msg, sizeof (msg));
+    assert(rc == 11);
+    assert(first_tid == child_tid);
+
+    child_tid = Create(9, &test_batch_receive_last_sender);
+    ops[0].op  = BATCH_REPLY;
+    ops[0].tid = first_tid;
+    ops[0].buf = NULL;
+    ops[0].len = 0;
+    ops[1].op  = BATCH_RECEIVE;
+    ops[1].tid = -42;
+    ops[1].buf = msg;
+    ops[1].len = sizeof (msg);
+    rc = Batch(ops, 2);
+    assert(ops[0].rc == 0);
+    assert(rc == 11);
+    assert(ops[1].tid == child_tid);
+    assert(strcmp(msg, "foobar baz") == 0);
+    rc = Reply(child_tid, NULL, 0);
+    assert(rc == 0);
+}
+
+static int reply_multi_order[4];
+static int reply_multi_count;
+static void
+test_reply_multi_sender(void)
+{
+    int reply = -1, replylen;
+    replylen = Send(MyParentTid(), NULL, 0, &reply, sizeof (reply));
+    assert(replylen == sizeof (reply));
+    assert(reply == 1234);
+    reply_multi_order[reply_multi_count++] = MyTid();
+}
+
+static void
+test_reply_multi(void)
+{
+    static const int prios[4] = { 6, 5, 6, 4 };
+    tid_t tids[5];
+    int i, rc, reply = 1234;
+
+    reply_multi_count = 0;
+    for (i = 0; i < 4; i++) {
+        Create(prios[i], &test_reply_multi_sender);
+        rc = Receive(&tids[i], NULL, 0);
+        assert(rc == 0);
+    }
+    tids[4] = 1 << 16; /* skipped */
+
+    /* Too long to copy whole: nobody is replied to */
+    rc = ReplyMulti(tids, 5, &reply, IPC_COPY_CHUNK + 1);
+    assert(rc == -1);
+
+    /* Everyone wakes up at once, highest priority first */
+    rc = ReplyMulti(tids, 5, &reply, sizeof (reply));
+    assert(rc == 4);
+    assert(reply_multi_count == 4);
+    assert(reply_multi_order[0] == tids[3]);
+    assert(reply_multi_order[1] == tids[1]);
+    assert(reply_multi_order[2] == tids[0]);
+    assert(reply_multi_order[3] == tids[2]);
+}
@@ -0,0 +1,7 @@
+#ifdef TEST_BATCH_H
+#error "double-included test_batch.h"
+#endif
+
+#define TEST_BATCH_H
+
+void test_batch_all(void);
@@ -0,0 +1,150 @@
+#include "test/test_chan.h"
+
+#include "config.h"
+#include "xbool.h"
+#include "xint.h"
+#include "xdef.h"
+#include "static_assert.h"
+#include "u_tid.h"
+#include "task.h"
+#include "event.h"
+#include "kern.h"
+
+#include "xassert.h"
+#include "u_syscall.h"
+#include "chan.h"
+
+#include "xarg.h"
+#include "bwio.h"
+
+#define TEST(init) test_chan_kern(#init, &init)
+
+#define CHAN_SIZE   256
+#define STREAM_LEN  100000
+
+static void test_chan_kern(const char *name, void (*)(void));
+
+static void test_chan_basic(void);
+static void test_chan_park(void);
+static void test_chan_stream(void);
+
+static struct chan g_chan;
+static char        g_chan_mem[CHAN_SIZE];
+
+void
+test_chan_all(void)
+{
+    TEST(test_chan_basic);
+    TEST(test_chan_park);
+    TEST(test_chan_stream);
+}
+
+static void
+test_chan_kern(const char *name, void (*init)(void))
+{
+    struct kparam kp = { .init = init, .init_prio = 8, .show_top = false };
+    bwprintf("%s...", name);
+    kern_main(&kp);
+    bwputstr("ok\n\r");
+}
+
+/* One task on both ends: wrapping, and writes that don't fit */
+static void
+test_chan_basic(void)
+{
+    char buf[CHAN_SIZE];
+    int i, round;
+    size_t n;
+
+    chan_init(&g_chan, g_chan_mem, CHAN_SIZE, MyTid());
+    assert(chan_read(&g_chan, buf, sizeof (buf)) == 0);
+
+    for (round = 0; round < 5; round++) {
+        for (i = 0; i < 100; i++)
+            buf[i] = (char)(round + i);
+        n = chan_write(&g_chan, buf, 100);
+        assert(n == 100);
+        assert(chan_used(&g_chan) == 100);
+        n = chan_read(&g_chan, buf, sizeof (buf));
+        assert(n == 100);
+        for (i = 0; i < 100; i++)
+            assert(buf[i] == (char)(round + i));
+    }
+
+    n = chan_write(&g_chan, buf, CHAN_SIZE);
+    assert(n == CHAN_SIZE);
+    assert(chan_free(&g_chan) == 0);
+    assert(chan_write(&g_chan, buf, 1) == 0);
+    assert(chan_read(&g_chan, buf, 10) == 10);
+    assert(chan_write(&g_chan, buf, 20) == 10);
+}
+
+static tid_t g_parker;
+static int   g_park_step;
+
+static void
+test_chan_park_waker(void)
+{
+    g_park_step = 1;
+    assert(Unpark(g_parker) == 0);
+}
+
+/* Unpark() before Park() isn't lost, and several count as one */
+static void
+test_chan_park(void)
+{
+    g_parker = MyTid();
+    assert(Unpark(g_parker) == 0);
+    assert(Unpark(g_parker) == 0);
+    assert(Park() == 0);
+
+    /* The token is gone, so this blocks until the waker runs */
+    g_park_step = 0;
+    Create(9, &test_chan_park_waker);
+    assert(Park() == 0);
+    assert(g_park_step == 1);
+
+    assert(Unpark(-1) == -1);
+}
+
+static void
+test_chan_producer(void)
+{
+    char buf[64];
+    int sent = 0, i, n;
+
+    while (sent < STREAM_LEN) {
+        /* Uneven chunks, to exercise the wrap */
+        n = 1 + sent % 61;
+        if (n > STREAM_LEN - sent)
+            n = STREAM_LEN - sent;
+        for (i = 0; i < n; i++)
+            buf[i] = (char)((sent + i) * 13);
+        i = 0;
+        while (i < n) {
+            i += chan_write(&g_chan, buf + i, n - i);
+            if (i < n)
+                Pass();
+        }
+        sent += n;
+    }
+}
+
+/* The consumer parks whenever the producer falls behind */
+static void
+test_chan_stream(void)
+{
+    char buf[100];
+    int got = 0, i, n;
+
+    chan_init(&g_chan, g_chan_mem, CHAN_SIZE, MyTid());
+    Create(9, &test_chan_producer);
+    while (got < STREAM_LEN) {
+        n = chan_read_wait(&g_chan, buf, sizeof (buf));
+        assert(n > 0);
+        for (i = 0; i < n; i++)
+            assert(buf[i] == (char)((got + i) * 13));
+        got += n;
+    }
+    assert(got == STREAM_LEN);
+}
@@ -0,0 +1,7 @@
+#ifdef TEST_CHAN_H
+#error "double-included test_chan.h"
+#endif
+
+#define TEST_CHAN_H
+
+void test_chan_all(void);
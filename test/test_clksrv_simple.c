@@ -64,6 +64,8 @@ test_clksrv_simple_init(void)
     clkctx_init(&clkctx);
     for (;;) {
         int rc, time = Time(&clkctx);
+        unsigned int us = TimeUs(&clkctx);
+        assert(us / 1000 >= (unsigned int)time && us / 1000 <= (unsigned int)time + 1);
         if (time != oldtime) {
             oldtime = time;
             tlog_printf(&clksrv_log, "%d\n", time);
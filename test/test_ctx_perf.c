@@ -0,0 +1,115 @@
+/* Perf test - assertions may be turned off. */
+
+#include "test/test_ctx_perf.h"
+
+#include "config.h"
+#include "xbool.h"
+#include "xint.h"
+#include "xdef.h"
+#include "static_assert.h"
+#include "u_tid.h"
+#include "task.h"
+#include "event.h"
+#include "kern.h"
+
+#include "xassert.h"
+#include "pmu.h"
+#include "u_syscall.h"
+
+#include "xarg.h"
+#include "bwio.h"
+
+#define NTRIALS 10000
+
+static void measure(const char *name, void (*init)(void));
+static void ctx_perf_pass(void);
+static void ctx_perf_mytid(void);
+static void ctx_perf_srr(void);
+static void ctx_perf_srr_receiver(void);
+
+struct ctx_perf_sample {
+    uint32_t cycles;
+    uint32_t dmiss;
+    uint32_t imiss;
+};
+
+static struct ctx_perf_sample g_start, g_end;
+static void sample(struct ctx_perf_sample *s);
+
+/* Cycles and L1 misses per trap, with all the kernel work on the way. */
+void
+test_ctx_perf(void)
+{
+    bwputstr("test_ctx_perf...\n\r");
+    pmu_init();
+    measure("Pass", &ctx_perf_pass);
+    measure("MyTid", &ctx_perf_mytid);
+    measure("Send/Receive/Reply", &ctx_perf_srr);
+}
+
+static void
+measure(const char *name, void (*init)(void))
+{
+    struct kparam kp = { .init = init, .init_prio = 8, .show_top = false };
+    kern_main(&kp);
+    bwprintf("  %s\t%u cycles\t%u.%02u D-miss\t%u.%02u I-miss\n\r",
+        name,
+        (g_end.cycles - g_start.cycles) / NTRIALS,
+        (g_end.dmiss - g_start.dmiss) / NTRIALS,
+        (g_end.dmiss - g_start.dmiss) * 100 / NTRIALS % 100,
+        (g_end.imiss - g_start.imiss) / NTRIALS,
+        (g_end.imiss - g_start.imiss) * 100 / NTRIALS % 100);
+}
+
+static void
+sample(struct ctx_perf_sample *s)
+{
+    s->cycles = pmu_cycles();
+    s->dmiss  = pmu_events(PMU_DCACHE_MISS);
+    s->imiss  = pmu_events(PMU_ICACHE_MISS);
+}
+
+static void
+ctx_perf_pass(void)
+{
+    int i;
+    sample(&g_start);
+    for (i = 0; i < NTRIALS; i++)
+        Pass();
+    sample(&g_end);
+}
+
+static void
+ctx_perf_mytid(void)
+{
+    int i;
+    sample(&g_start);
+    for (i = 0; i < NTRIALS; i++)
+        MyTid();
+    sample(&g_end);
+}
+
+static void
+ctx_perf_srr(void)
+{
+    tid_t tid;
+    int i, msg = 0, rply;
+
+    tid = Create(7, &ctx_perf_srr_receiver);
+    assert(tid >= 0);
+    sample(&g_start);
+    for (i = 0; i < NTRIALS; i++)
+        Send(tid, &msg, sizeof (msg), &rply, sizeof (rply));
+    sample(&g_end);
+}
+
+static void
+ctx_perf_srr_receiver(void)
+{
+    tid_t sender;
+    int i, msg;
+    for (i = 0; i < NTRIALS; i++) {
+        Receive(&sender, &msg, sizeof (msg));
+        Reply(sender, &msg, sizeof (msg));
+    }
+}
@@ -0,0 +1,7 @@
+#ifdef TEST_CTX_PERF_H
+#error "double-included test_ctx_perf.h"
+#endif
+
+#define TEST_CTX_PERF_H
+
+void test_ctx_perf(void);
@@ -0,0 +1,123 @@
+/* Cyclic executive test. Two jobs share a 20 ms major frame with a
+ * task that never blocks, at a higher priority than either: the jobs
+ * still run in each of their slots, and an overrun is reported. */
+
+#include "test/test_cyclic.h"
+
+#include "config.h"
+#include "xbool.h"
+#include "xint.h"
+#include "xdef.h"
+#include "static_assert.h"
+#include "u_tid.h"
+#include "task.h"
+#include "event.h"
+#include "kern.h"
+
+#include "xassert.h"
+#include "u_syscall.h"
+#include "array_size.h"
+#include "cyclic.h"
+
+#include "xarg.h"
+#include "bwio.h"
+
+#define CYCLIC_ROUNDS 20
+
+static void cyclic_init_task(void);
+static void cyclic_hog(void);
+static void cyclic_job0(void);
+static void cyclic_job1(void);
+
+/* Job 0 twice per major frame, job 1 once */
+static const struct cyclic_slot g_slots[] = {
+    { .frame = 0, .job = 0, .start_us = 0,    .len_us = 2000 },
+    { .frame = 1, .job = 0, .start_us = 0,    .len_us = 2000 },
+    { .frame = 1, .job = 1, .start_us = 5000, .len_us = 1000 },
+};
+
+static const struct cyclic_table g_table = {
+    .minor_us = 10000,
+    .n_minor  = 2,
+    .n_slots  = ARRAY_SIZE(g_slots),
+    .slots    = g_slots
+};
+
+static volatile int g_job0_runs;
+static volatile int g_job1_rc;
+
+void
+test_cyclic(void)
+{
+    struct kparam kp = {
+        .init      = &cyclic_init_task,
+        .init_prio = 8,
+        .show_top  = false,
+        .cyclic    = &g_table
+    };
+    bwputstr("test_cyclic...");
+    g_job0_runs = 0;
+    g_job1_rc   = -1;
+    kern_main(&kp);
+    bwputstr("ok\n\r");
+}
+
+static void
+cyclic_init_task(void)
+{
+    int rc;
+
+    assert(CyclicWait(-1) == -1);
+    assert(CyclicWait(CYCLIC_MAX_JOBS) == -1);
+
+    /* The jobs claim their slots as soon as they're created */
+    rc = Create(4, &cyclic_job0);
+    assertv(rc, rc >= 0);
+    rc = Create(4, &cyclic_job1);
+    assertv(rc, rc >= 0);
+
+    /* From here on only the slots let anything else run */
+    rc = Create(1, &cyclic_hog);
+    assertv(rc, rc >= 0);
+}
+
+static void
+cyclic_hog(void)
+{
+    for (;;) { }
+}
+
+static void
+cyclic_job0(void)
+{
+    int i, rc;
+
+    for (i = 0; i < CYCLIC_ROUNDS; i++) {
+        rc = CyclicWait(0);
+        assertv(rc, rc == 0);
+        g_job0_runs++;
+    }
+    assert(g_job1_rc == 1);
+    Shutdown();
+}
+
+static void
+cyclic_job1(void)
+{
+    int runs, rc;
+
+    rc = CyclicWait(1);
+    assertv(rc, rc == 0);
+    assert(CyclicWait(0) == -2);
+
+    /* Job 0 next runs in the following major frame, so this overruns
+       once, then finishes in our slot in that frame */
+    runs = g_job0_runs;
+    while (g_job0_runs < runs + 2) { }
+    g_job1_rc = CyclicWait(1);
+
+    for (;;) {
+        rc = CyclicWait(1);
+        assertv(rc, rc == 0);
+    }
+}
@@ -0,0 +1,7 @@
+#ifdef TEST_CYCLIC_H
+#error "double-included test_cyclic.h"
+#endif
+
+#define TEST_CYCLIC_H
+
+void test_cyclic(void);
@@ -86,7 +86,7 @@ u_clock(void)
     int ticks, rc;
 
     clock_init(100);
-    rc = RegisterEvent(51, &u_clock_cb);
+    rc = RegisterEvent(51, 0, 0, &u_clock_cb);
     assert(rc == 0);
 
     ticks = 0;
@@ -115,7 +115,7 @@ foo(void)
 {
     int ticks, rc;
 
-    rc = RegisterEvent(21, &foo_cb);
+    rc = RegisterEvent(21, 0, 0, &foo_cb);
     assert(rc == 0);
 
     ticks = 0;
@@ -140,7 +140,7 @@ bar(void)
 {
     int ticks, rc;
 
-    rc = RegisterEvent(22, &bar_cb);
+    rc = RegisterEvent(22, 0, 0, &bar_cb);
     assert(rc == 0);
 
     ticks = 0;
@@ -0,0 +1,214 @@
+/* Event flag tests. Interrupts are raised in software through
+ * INTC_ISR_SET on lines that nothing else here uses, and each callback
+ * takes its line back down through INTC_ISR_CLEAR. */
+
+#include "test/test_event_flags.h"
+
+#include "config.h"
+#include "xbool.h"
+#include "xint.h"
+#include "xdef.h"
+#include "static_assert.h"
+#include "u_tid.h"
+#include "task.h"
+#include "event.h"
+#include "kern.h"
+
+#include "xassert.h"
+#include "u_syscall.h"
+#include "event_flags.h"
+
+#include "interrupt.h"
+#include "fiq.h"
+
+#include "xarg.h"
+#include "bwio.h"
+
+#define TEST(init) test_event_flags_kern(#init, &init)
+
+#define IRQ_A       SYS_INT_DMA_INTR_PIN0
+#define IRQ_B       SYS_INT_DMA_INTR_PIN1
+#define IRQ_PRIO    8
+
+static void test_event_flags_kern(const char *name, void (*)(void));
+
+static void test_evt_count_burst(void);
+static void test_evt_await_any(void);
+static void test_evt_msg_latched(void);
+static void test_fiq_bad_chan(void);
+
+static void evt_raise(int irq);
+static void evt_raise_b(void);
+static void evt_hold_b(void);
+static int evt_a_cb(void*, size_t);
+static int evt_b_cb(void*, size_t);
+
+static volatile int g_fired;
+
+void
+test_event_flags_all(void)
+{
+    TEST(test_evt_count_burst);
+    TEST(test_evt_await_any);
+    TEST(test_evt_msg_latched);
+    TEST(test_fiq_bad_chan);
+}
+
+static void
+test_event_flags_kern(const char *name, void (*init)(void))
+{
+    struct kparam kp = { .init = init, .init_prio = 8, .show_top = false };
+    g_fired = 0;
+    bwprintf("%s...", name);
+    kern_main(&kp);
+    bwputstr("ok\n\r");
+}
+
+/* Several occurrences while the owner is busy come back together
+   from one AwaitEvent() */
+static void
+test_evt_count_burst(void)
+{
+    int i, rc;
+
+    rc = RegisterEvent(IRQ_A, IRQ_PRIO, EVT_COUNT, &evt_a_cb);
+    assertv(rc, rc == 0);
+
+    for (i = 0; i < 3; i++)
+        evt_raise(IRQ_A);
+    assert(g_fired == 3);
+
+    rc = AwaitEvent(NULL, 0);
+    assertv(rc, rc == 3);
+
+    /* The count starts over */
+    evt_raise(IRQ_A);
+    rc = AwaitEvent(NULL, 0);
+    assertv(rc, rc == 1);
+}
+
+/* One waiter on two IRQs learns which one woke it */
+static void
+test_evt_await_any(void)
+{
+    int irq, rc;
+
+    rc = RegisterEvent(IRQ_A, IRQ_PRIO, 0, &evt_a_cb);
+    assertv(rc, rc == 0);
+    rc = RegisterEvent(IRQ_B, IRQ_PRIO, 0, &evt_b_cb);
+    assertv(rc, rc == 0);
+
+    /* Both raised while masked: each is picked up by polling,
+       the one served first goes behind the other */
+    IntSoftwareIntSet(IRQ_A);
+    IntSoftwareIntSet(IRQ_B);
+    irq = -1;
+    rc = AwaitAnyEvent(NULL, 0, &irq);
+    assertv(rc, rc == 1);
+    assert(irq == IRQ_A);
+    rc = AwaitAnyEvent(NULL, 0, &irq);
+    assertv(rc, rc == 2);
+    assert(irq == IRQ_B);
+
+    /* Only B, raised by a less important task while we're blocked */
+    rc = Create(IRQ_PRIO + 1, &evt_raise_b);
+    assertv(rc, rc >= 0);
+    irq = -1;
+    rc = AwaitAnyEvent(NULL, 0, &irq);
+    assertv(rc, rc == 2);
+    assert(irq == IRQ_B);
+    assert(g_fired == 3);
+}
+
+/* Occurrences while a server is busy wait for its next Receive(),
+   which gets them as one message */
+static void
+test_evt_msg_latched(void)
+{
+    struct evt_msg msg;
+    int tid, rc;
+
+    rc = RegisterEvent(IRQ_A, IRQ_PRIO, EVT_MSG, &evt_a_cb);
+    assertv(rc, rc == 0);
+
+    evt_raise(IRQ_A);
+    evt_raise(IRQ_A);
+    assert(g_fired == 2);
+
+    tid = -1;
+    rc = Receive(&tid, &msg, sizeof (msg));
+    assertv(rc, rc == sizeof (msg));
+    assert(tid == EVT_TID(IRQ_A));
+    assert(msg.count == 2);
+    assert(msg.rc == 1);
+}
+
+/* The kernel checks the channel before routing a line to FIQ */
+static void
+test_fiq_bad_chan(void)
+{
+    static struct fiq_chan chan;
+    tid_t tid;
+
+    assert(RegisterFiq(IRQ_A, NULL) == FIQ_BAD_CHAN);
+
+    fiq_chan_init(&chan, NULL, NULL, 0, IRQ_COUNT);
+    assert(RegisterFiq(IRQ_A, &chan) == FIQ_BAD_CHAN);
+    fiq_chan_init(&chan, NULL, NULL, 0, -2);
+    assert(RegisterFiq(IRQ_A, &chan) == FIQ_BAD_CHAN);
+    fiq_chan_init(&chan, NULL, NULL, 0, IRQ_A);
+    assert(RegisterFiq(IRQ_A, &chan) == FIQ_BAD_CHAN);
+
+    /* Someone else's event can't be the wake IRQ */
+    tid = Create(IRQ_PRIO - 1, &evt_hold_b);
+    assertv(tid, tid >= 0);
+    fiq_chan_init(&chan, NULL, NULL, 0, IRQ_B);
+    assert(RegisterFiq(IRQ_A, &chan) == IRQ_IN_USE);
+}
+
+/* Raise a line that stays enabled, and wait until its callback has
+   run, so that occurrences don't merge in the interrupt controller */
+static void
+evt_raise(int irq)
+{
+    int fired = g_fired;
+    IntSoftwareIntSet(irq);
+    while (g_fired == fired) { }
+}
+
+static void
+evt_raise_b(void)
+{
+    IntSoftwareIntSet(IRQ_B);
+}
+
+/* Registers B, then stays out of the way */
+static void
+evt_hold_b(void)
+{
+    tid_t tid;
+    int rc;
+    rc = RegisterEvent(IRQ_B, IRQ_PRIO, 0, &evt_b_cb);
+    assertv(rc, rc == 0);
+    Receive(&tid, NULL, 0);
+}
+
+static int
+evt_a_cb(void *ptr, size_t size)
+{
+    (void)ptr;
+    (void)size;
+    IntSoftwareIntClear(IRQ_A);
+    g_fired++;
+    return 1;
+}
+
+static int
+evt_b_cb(void *ptr, size_t size)
+{
+    (void)ptr;
+    (void)size;
+    IntSoftwareIntClear(IRQ_B);
+    g_fired++;
+    return 2;
+}
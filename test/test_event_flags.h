@@ -0,0 +1,7 @@
+#ifdef TEST_EVENT_FLAGS_H
+#error "double-included test_event_flags.h"
+#endif
+
+#define TEST_EVENT_FLAGS_H
+
+void test_event_flags_all(void);
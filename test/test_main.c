@@ -14,7 +14,17 @@
 #include "test/test_clksrv_simple.h"
 #include "test/test_clksrv_more.h"
 #include "test/test_ipc_perf.h"
+#include "test/test_ctx_perf.h"
 #include "test/test_queue_impl.h"
+#include "test/test_batch.h"
+#include "test/test_task.h"
+#include "test/test_wcet.h"
+#include "test/test_chan.h"
+#include "test/test_seqlock_perf.h"
+#include "test/test_cyclic.h"
+#include "test/test_mbox.h"
+#include "test/test_txn.h"
+#include "test/test_event_flags.h"
 
 int
 main(void)
@@ -27,10 +37,20 @@ main(void)
     test_ipc_all();
     test_nsblk_all();
     test_event_all();
+    test_event_flags_all();
     test_clksrv_simple();
     test_clksrv_more();
     test_ipc_perf();
+    test_ctx_perf();
     test_queue_impl();
+    test_batch_all();
+    test_task_all();
+    test_wcet();
+    test_chan_all();
+    test_mbox_all();
+    test_txn_all();
+    test_seqlock_perf();
+    test_cyclic();
 
     return 0;
 }
@@ -0,0 +1,172 @@
+#include "test/test_mbox.h"
+
+#include "config.h"
+#include "xbool.h"
+#include "xint.h"
+#include "xdef.h"
+#include "static_assert.h"
+#include "u_tid.h"
+#include "task.h"
+#include "event.h"
+#include "kern.h"
+
+#include "xassert.h"
+#include "u_syscall.h"
+#include "batch.h"
+#include "xstring.h"
+
+#include "xarg.h"
+#include "bwio.h"
+
+#define TEST(init) test_mbox_kern(#init, &init)
+
+/* Room for 4 messages of up to 8 bytes, each with its length */
+#define MBOX_MSG    8
+#define MBOX_ROOM   (4 * (sizeof (int) + MBOX_MSG))
+
+static void test_mbox_kern(const char *name, void (*)(void));
+
+static void test_mbox_reject(void);
+static void test_mbox_overwrite(void);
+static void test_mbox_block(void);
+static void test_mbox_fetcher(void);
+static void test_mbox_batch(void);
+
+static int g_mem[MBOX_ROOM / sizeof (int)];
+static int g_mbox;
+
+void
+test_mbox_all(void)
+{
+    TEST(test_mbox_reject);
+    TEST(test_mbox_overwrite);
+    TEST(test_mbox_block);
+    TEST(test_mbox_batch);
+}
+
+static void
+test_mbox_kern(const char *name, void (*init)(void))
+{
+    struct kparam kp = { .init = init, .init_prio = 8, .show_top = false };
+    bwprintf("%s...", name);
+    kern_main(&kp);
+    bwputstr("ok\n\r");
+}
+
+/* Messages come out in order; a full mailbox refuses more */
+static void
+test_mbox_reject(void)
+{
+    char buf[MBOX_MSG];
+    int mb, i, rc;
+
+    assert(MboxCreate(NULL, MBOX_ROOM, MBOX_MSG, MBOX_REJECT) == -1);
+    assert(MboxCreate(g_mem, MBOX_ROOM, 0, MBOX_REJECT) == -1);
+    assert(MboxCreate(g_mem, MBOX_ROOM, MBOX_MSG, 7) == -1);
+    assert(MboxCreate(g_mem, 4, MBOX_MSG, MBOX_REJECT) == -2);
+    mb = MboxCreate(g_mem, MBOX_ROOM, MBOX_MSG, MBOX_REJECT);
+    assertv(mb, mb == 0);
+
+    assert(Post(mb + 1, "x", 1) == -1);
+    assert(Post(mb, "too long!", 9) == -2);
+    for (i = 0; i < 4; i++) {
+        buf[0] = '0' + i;
+        rc = Post(mb, buf, i + 1);
+        assertv(rc, rc == 0);
+    }
+    assert(Post(mb, "x", 1) == -3);
+
+    for (i = 0; i < 4; i++) {
+        rc = Fetch(mb, buf, sizeof (buf));
+        assertv(rc, rc == i + 1);
+        assert(buf[0] == '0' + i);
+    }
+
+    /* Truncated, but the length says so */
+    assert(Post(mb, "abcdef", 6) == 0);
+    assert(Fetch(mb, buf, 2) == 6);
+    assert(buf[0] == 'a' && buf[1] == 'b');
+    assert(Fetch(mb, buf, -1) == -2);
+}
+
+/* A full mailbox makes room by dropping the oldest message */
+static void
+test_mbox_overwrite(void)
+{
+    char c;
+    int mb, i, rc;
+
+    mb = MboxCreate(g_mem, MBOX_ROOM, MBOX_MSG, MBOX_OVERWRITE);
+    assertv(mb, mb >= 0);
+    for (i = 0; i < 6; i++) {
+        c  = 'a' + i;
+        rc = Post(mb, &c, 1);
+        assertv(rc, rc == (i < 4 ? 0 : 1));
+    }
+    for (i = 2; i < 6; i++) {
+        rc = Fetch(mb, &c, 1);
+        assertv(rc, rc == 1);
+        assert(c == 'a' + i);
+    }
+}
+
+static void
+test_mbox_fetcher(void)
+{
+    char buf[MBOX_MSG];
+    int rc;
+
+    rc = Fetch(g_mbox, buf, sizeof (buf));
+    assertv(rc, rc == 6);
+    assert(strcmp(buf, "hello") == 0);
+    rc = Post(g_mbox + 1, "bye", 4);
+    assertv(rc, rc == 0);
+}
+
+/* A waiting Fetch() gets the message directly, and the poster never
+   blocks even though the fetcher is more important */
+static void
+test_mbox_block(void)
+{
+    char buf[MBOX_MSG];
+    int rc;
+
+    g_mbox = MboxCreate(g_mem, MBOX_ROOM / 2, MBOX_MSG, MBOX_REJECT);
+    assertv(g_mbox, g_mbox >= 0);
+    rc = MboxCreate(
+        &g_mem[MBOX_ROOM / 2 / sizeof (int)],
+        MBOX_ROOM / 2,
+        MBOX_MSG,
+        MBOX_REJECT);
+    assertv(rc, rc == g_mbox + 1);
+
+    rc = Create(7, &test_mbox_fetcher);
+    assertv(rc, rc >= 0);
+    assert(Post(g_mbox, "hello", 6) == 0);
+    rc = Fetch(g_mbox + 1, buf, sizeof (buf));
+    assertv(rc, rc == 4);
+    assert(strcmp(buf, "bye") == 0);
+}
+
+/* Posting from a batch, ahead of a blocking operation */
+static void
+test_mbox_batch(void)
+{
+    struct batch_op ops[3];
+    char buf[MBOX_MSG];
+    int mb, rc;
+
+    mb = MboxCreate(g_mem, MBOX_ROOM, MBOX_MSG, MBOX_REJECT);
+    assertv(mb, mb >= 0);
+    ops[0] = (struct batch_op){ BATCH_POST, mb, "one", 4, 0 };
+    ops[1] = (struct batch_op){ BATCH_POST, mb, "two", 4, 0 };
+    ops[2] = (struct batch_op){ BATCH_POST, mb, "much too long", 13, 0 };
+    rc = Batch(ops, 3);
+    assertv(rc, rc == 0);
+    assert(ops[0].rc == 0 && ops[1].rc == 0 && ops[2].rc == -2);
+
+    assert(Fetch(mb, buf, sizeof (buf)) == 4);
+    assert(strcmp(buf, "one") == 0);
+    assert(Fetch(mb, buf, sizeof (buf)) == 4);
+    assert(strcmp(buf, "two") == 0);
+}
@@ -0,0 +1,7 @@
+#ifdef TEST_MBOX_H
+#error "double-included test_mbox.h"
+#endif
+
+#define TEST_MBOX_H
+
+void test_mbox_all(void);
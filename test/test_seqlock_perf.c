@@ -0,0 +1,146 @@
+/* Perf test - assertions may be turned off.
+ * Readers of a shared value: a server answering Send()s, against a
+ * seqlock. */
+
+#include "test/test_seqlock_perf.h"
+
+#include "config.h"
+#include "xbool.h"
+#include "xint.h"
+#include "xdef.h"
+#include "static_assert.h"
+#include "u_tid.h"
+#include "task.h"
+#include "event.h"
+#include "kern.h"
+
+#include "xassert.h"
+#include "pmu.h"
+#include "seqlock.h"
+#include "u_syscall.h"
+
+#include "xarg.h"
+#include "bwio.h"
+
+#define NREADS      1000
+#define MAX_READERS 64
+
+/* Something pose-sized */
+struct pose {
+    int32_t  x, y, theta;
+    uint32_t time;
+    int32_t  vx, vy, omega;
+    uint32_t seq;
+};
+
+static void measure(int readers, void (*init)(void));
+static void seqlock_perf_server(void);
+static void seqlock_perf_srv_reader(void);
+static void seqlock_perf_srv_main(void);
+static void seqlock_perf_seq_reader(void);
+static void seqlock_perf_seq_main(void);
+
+static int            g_readers;
+static uint32_t       g_cycles;
+static tid_t          g_server;
+static struct seqlock g_lock;
+static struct pose    g_copies[2];
+
+void
+test_seqlock_perf(void)
+{
+    int readers;
+    bwputstr("test_seqlock_perf...\n\r");
+    pmu_init();
+    bwputstr("  READERS\tSERVER\tSEQLOCK (cycles/read)\n\r");
+    for (readers = 1; readers <= MAX_READERS; readers *= 2) {
+        uint32_t srv, seq;
+        measure(readers, &seqlock_perf_srv_main);
+        srv = g_cycles;
+        measure(readers, &seqlock_perf_seq_main);
+        seq = g_cycles;
+        bwprintf("  %d\t\t%u\t%u\n\r", readers, srv, seq);
+    }
+}
+
+static void
+measure(int readers, void (*init)(void))
+{
+    struct kparam kp = { .init = init, .init_prio = 8, .show_top = false };
+    g_readers = readers;
+    kern_main(&kp);
+}
+
+/* Start the readers, which run once we block, and wait for them all */
+static void
+seqlock_perf_run(void (*reader)(void))
+{
+    uint32_t start;
+    tid_t tid;
+    int i;
+
+    for (i = 0; i < g_readers; i++)
+        Create(9, reader);
+    start = pmu_cycles();
+    for (i = 0; i < g_readers; i++) {
+        Receive(&tid, NULL, 0);
+        Reply(tid, NULL, 0);
+    }
+    g_cycles = (pmu_cycles() - start) / (g_readers * NREADS);
+}
+
+/* The server pattern: every read is a Send() to the owner */
+static void
+seqlock_perf_server(void)
+{
+    struct pose pose = { 0 };
+    tid_t tid;
+    for (;;) {
+        Receive(&tid, NULL, 0);
+        pose.seq++;
+        Reply(tid, &pose, sizeof (pose));
+    }
+}
+
+static void
+seqlock_perf_srv_reader(void)
+{
+    struct pose pose;
+    int i, rc;
+    for (i = 0; i < NREADS; i++) {
+        rc = Send(g_server, NULL, 0, &pose, sizeof (pose));
+        assertv(rc, rc == sizeof (pose));
+    }
+    Send(MyParentTid(), NULL, 0, NULL, 0);
+}
+
+static void
+seqlock_perf_srv_main(void)
+{
+    g_server = Create(7, &seqlock_perf_server);
+    seqlock_perf_run(&seqlock_perf_srv_reader);
+    Destroy(g_server);
+}
+
+/* The seqlock: readers copy the value straight out */
+static void
+seqlock_perf_seq_reader(void)
+{
+    struct pose pose;
+    uint32_t last = 0, v;
+    int i;
+    for (i = 0; i < NREADS; i++) {
+        v = seqlock_read(&g_lock, &pose);
+        assertv(v, v >= last);
+        last = v;
+    }
+    Send(MyParentTid(), NULL, 0, NULL, 0);
+}
+
+static void
+seqlock_perf_seq_main(void)
+{
+    struct pose pose = { 0 };
+    seqlock_init(&g_lock, &g_copies[0], &g_copies[1], sizeof (pose), &pose);
+    seqlock_perf_run(&seqlock_perf_seq_reader);
+}
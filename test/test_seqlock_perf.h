@@ -0,0 +1,7 @@
+#ifdef TEST_SEQLOCK_PERF_H
+#error "double-included test_seqlock_perf.h"
+#endif
+
+#define TEST_SEQLOCK_PERF_H
+
+void test_seqlock_perf(void);
@@ -0,0 +1,404 @@
+#undef NOASSERT
+
+#include "test/test_task.h"
+
+#include "config.h"
+#include "xbool.h"
+#include "xint.h"
+#include "xdef.h"
+#include "static_assert.h"
+#include "u_tid.h"
+#include "task.h"
+#include "event.h"
+#include "kern.h"
+
+#include "xassert.h"
+#include "xstring.h"
+#include "xmemcpy.h"
+#include "u_syscall.h"
+#include "link.h"
+
+#include "xarg.h"
+#include "bwio.h"
+
+#define TEST(init) test_task_kern(#init, &init)
+
+static void test_task_kern(const char *name, void (*)(void));
+
+static void test_createarg(void);
+static void test_destroy_errors(void);
+static void test_destroy_ready(void);
+static void test_destroy_server(void);
+static void test_destroy_sender(void);
+static void test_create_ocmc(void);
+static void test_long_copy(void);
+static void test_budget(void);
+static void test_period(void);
+static void test_thumb_float(void);
+
+void
+test_task_all(void)
+{
+    TEST(test_createarg);
+    TEST(test_destroy_errors);
+    TEST(test_destroy_ready);
+    TEST(test_destroy_server);
+    TEST(test_destroy_sender);
+    TEST(test_create_ocmc);
+    TEST(test_long_copy);
+    TEST(test_budget);
+    TEST(test_period);
+    TEST(test_thumb_float);
+}
+
+static void
+test_task_kern(const char *name, void (*init)(void))
+{
+    struct kparam kp = { .init = init, .init_prio = 8, .show_top = false };
+    bwprintf("%s...", name);
+    kern_main(&kp);
+    bwputstr("ok\n\r");
+}
+
+struct createarg_arg {
+    int  n;
+    char name[6];
+};
+
+static int g_createarg_ran;
+
+static void
+test_createarg_child(void *p, size_t size)
+{
+    struct createarg_arg *arg = p;
+    assert(size == sizeof (*arg));
+    assert(((uintptr_t)arg & 7) == 0);
+    assert(arg->n == 42);
+    assert(strcmp(arg->name, "child") == 0);
+    g_createarg_ran++;
+}
+
+static void
+test_createarg_noarg(void *p, size_t size)
+{
+    assert(p == NULL);
+    assert(size == 0);
+    g_createarg_ran++;
+}
+
+static void
+test_createarg(void)
+{
+    struct createarg_arg arg = { .n = 42, .name = "child" };
+    tid_t tid;
+
+    g_createarg_ran = 0;
+    tid = CreateArg(7, &test_createarg_child, &arg, sizeof (arg));
+    assert(tid >= 0);
+    assert(g_createarg_ran == 1);
+
+    /* The child has its own copy, so it doesn't see this change */
+    tid = CreateArg(9, &test_createarg_child, &arg, sizeof (arg));
+    assert(tid >= 0);
+    arg.n = 0;
+    tid = CreateArg(7, &test_createarg_noarg, NULL, 0);
+    assert(tid >= 0);
+    assert(g_createarg_ran == 2);
+
+    tid = CreateArg(7, &test_createarg_noarg, &arg, TASK_ARG_MAX + 1);
+    assert(tid == -3);
+}
+
+static void
+test_destroy_errors(void)
+{
+    assert(Destroy(1 << 16) == -1);
+    assert(Destroy(MyTid() + (1 << 8)) == -2);
+    assert(Destroy(0) == -3); /* idle task */
+}
+
+static bool g_destroy_ran;
+
+static void
+test_destroy_never(void)
+{
+    g_destroy_ran = true;
+}
+
+static void
+test_destroy_ready(void)
+{
+    tid_t tid;
+
+    g_destroy_ran = false;
+    tid = Create(9, &test_destroy_never);
+    assert(tid >= 0);
+    assert(Destroy(tid) == 0);
+    assert(Destroy(tid) == -2);
+    Pass();
+    assert(!g_destroy_ran);
+}
+
+static int   g_destroy_rc;
+static tid_t g_destroy_srv;
+
+static void
+test_destroy_client(void)
+{
+    char reply[4];
+    g_destroy_rc = Send(g_destroy_srv, "hi", 3, reply, sizeof (reply));
+}
+
+static void
+test_destroy_server(void)
+{
+    tid_t srv, client;
+
+    /* The client sends to the server, which never gets to run */
+    g_destroy_ran = false;
+    g_destroy_rc  = 0;
+    srv = Create(9, &test_destroy_never);
+    assert(srv >= 0);
+    g_destroy_srv = srv;
+    client = Create(7, &test_destroy_client);
+    assert(client >= 0);
+    assert(g_destroy_rc == 0);
+
+    assert(Destroy(srv) == 0);
+    assert(g_destroy_rc == -2);
+    assert(!g_destroy_ran);
+}
+
+static void
+test_destroy_sender_main(void)
+{
+    char reply[4];
+    int rc;
+    rc = Send(MyParentTid(), "hi", 3, reply, sizeof (reply));
+    assert(rc == 3);
+}
+
+static void
+test_destroy_sender(void)
+{
+    tid_t dead, live, tid;
+    char msg[4];
+    int rc;
+
+    dead = Create(7, &test_destroy_sender_main);
+    live = Create(7, &test_destroy_sender_main);
+    assert(Destroy(dead) == 0);
+
+    /* Only the live sender is still queued */
+    rc = Receive(&tid, msg, sizeof (msg));
+    assert(rc == 3);
+    assert(tid == live);
+    rc = Reply(tid, "ok", 3);
+    assert(rc == 0);
+}
+
+static int g_ocmc_ran;
+
+static void
+test_create_ocmc_child(void)
+{
+    char local;
+    assert(&local >= (char*)OcmcStacksStart);
+    assert(&local <  (char*)OcmcStacksEnd);
+    g_ocmc_ran++;
+    Send(MyParentTid(), NULL, 0, NULL, 0);
+}
+
+static void
+test_create_ocmc(void)
+{
+    tid_t tid;
+    int i, n = 0;
+
+    /* Use up the pool with children waiting on us */
+    g_ocmc_ran = 0;
+    while ((tid = Create(7 | CREATE_OCMC_STACK, &test_create_ocmc_child)) >= 0)
+        n++;
+    assert(tid == -4);
+    assert(n > 0);
+    assert(g_ocmc_ran == n);
+    assert(Create(-1 | CREATE_OCMC_STACK, &test_create_ocmc_child) == -1);
+
+    /* Once they've exited, the stacks can be had again */
+    for (i = 0; i < n; i++) {
+        Receive(&tid, NULL, 0);
+        Reply(tid, NULL, 0);
+    }
+    tid = Create(7 | CREATE_OCMC_STACK, &test_create_ocmc_child);
+    assert(tid >= 0);
+    assert(g_ocmc_ran == n + 1);
+    Receive(&tid, NULL, 0);
+    Reply(tid, NULL, 0);
+}
+
+/* Several chunks, and a ragged end */
+#define LONG_COPY_LEN (4 * IPC_COPY_CHUNK + 13)
+
+static char g_long_msg[LONG_COPY_LEN];
+static char g_long_rcv[LONG_COPY_LEN];
+static char g_long_rply[LONG_COPY_LEN];
+static char g_long_got[LONG_COPY_LEN];
+
+static void
+test_long_copy_fill(char *buf, int seed)
+{
+    int i;
+    for (i = 0; i < LONG_COPY_LEN; i++)
+        buf[i] = (char)(i * 7 + seed);
+}
+
+static void
+test_long_copy_check(const char *buf, int seed)
+{
+    int i;
+    for (i = 0; i < LONG_COPY_LEN; i++)
+        assert(buf[i] == (char)(i * 7 + seed));
+}
+
+static void
+test_long_copy_child(void)
+{
+    int rc;
+    memset(g_long_got, 0, sizeof (g_long_got));
+    rc = Send(MyParentTid(),
+        g_long_msg, sizeof (g_long_msg),
+        g_long_got, sizeof (g_long_got));
+    assert(rc == LONG_COPY_LEN);
+    test_long_copy_check(g_long_got, 2);
+}
+
+static void
+test_long_copy_serve(void)
+{
+    tid_t tid;
+    int rc;
+    memset(g_long_rcv, 0, sizeof (g_long_rcv));
+    rc = Receive(&tid, g_long_rcv, sizeof (g_long_rcv));
+    assert(rc == LONG_COPY_LEN);
+    test_long_copy_check(g_long_rcv, 1);
+    rc = Reply(tid, g_long_rply, sizeof (g_long_rply));
+    assert(rc == 0);
+}
+
+static void
+test_long_copy(void)
+{
+    test_long_copy_fill(g_long_msg, 1);
+    test_long_copy_fill(g_long_rply, 2);
+
+    /* Sender already waiting: the receiver does the copy */
+    Create(7, &test_long_copy_child);
+    test_long_copy_serve();
+
+    /* Receiver already waiting: the sender does the copy */
+    Create(9, &test_long_copy_child);
+    test_long_copy_serve();
+}
+
+static volatile unsigned g_budget_spins;
+
+/* Never blocks once started */
+static void
+test_budget_hog(void)
+{
+    tid_t tid;
+    Receive(&tid, NULL, 0);
+    Reply(tid, NULL, 0);
+    for (;;)
+        g_budget_spins++;
+}
+
+static void
+test_budget(void)
+{
+    struct budget_stats st;
+    unsigned spins;
+    tid_t hog;
+
+    /* Parked in Receive() until we've set its budget */
+    hog = Create(7, &test_budget_hog);
+    assert(SetBudget(hog, 2000, 1000) == -3);
+    assert(SetBudget(hog, 1000, 0) == -3);
+    assert(SetBudget(0, 1000, 10000) == -3);
+    assert(SetBudget(hog, 1000, 10000) == 0);
+
+    /* We only get to run again once the hog is throttled */
+    g_budget_spins = 0;
+    Send(hog, NULL, 0, NULL, 0);
+    assert(BudgetStats(hog, &st) == 0);
+    assert(st.throttled);
+    assert(st.overruns == 1);
+    assert(st.budget_us == 1000 && st.period_us == 10000);
+    spins = g_budget_spins;
+    assert(spins > 0);
+
+    /* It gets its budget back each period, and runs out again */
+    do {
+        assert(BudgetStats(hog, &st) == 0);
+    } while (st.overruns < 3);
+    assert(g_budget_spins > spins);
+
+    /* Lifting the budget would let it starve us; just kill it */
+    assert(Destroy(hog) == 0);
+}
+
+static void
+test_period(void)
+{
+    volatile unsigned spins;
+    int i, rc;
+
+    assert(WaitPeriod() == -1);
+    assert(SetPeriod(0x7fffffff, 0) == -1);
+
+    /* Nothing else is running, so every release is made */
+    rc = SetPeriod(1000, 1000);
+    assertv(rc, rc == 0);
+    for (i = 0; i < 4; i++) {
+        rc = WaitPeriod();
+        assertv(rc, rc == 0);
+    }
+
+    /* Spinning for well over a period misses releases, and the
+       one after that is on time again */
+    rc = SetPeriod(100, 0);
+    assertv(rc, rc == 0);
+    rc = WaitPeriod();
+    assertv(rc, rc == 0);
+    for (spins = 0; spins < 1000000; spins++) { }
+    rc = WaitPeriod();
+    assertv(rc, rc > 0);
+    rc = WaitPeriod();
+    assertv(rc, rc == 0);
+
+    assert(SetPeriod(0, 0) == 0);
+    assert(WaitPeriod() == -1);
+}
+
+static float g_thumb_result;
+
+/* The first floating point instruction traps to hand over the VFP
+   context, and has to be retried at the right address in Thumb state */
+static void __attribute__((target("thumb")))
+test_thumb_float_child(void)
+{
+    volatile float a = 1.5f, b = 2.25f;
+    g_thumb_result = a * b + a;
+}
+
+static void
+test_thumb_float(void)
+{
+    int rc;
+
+    assert(((uintptr_t)&test_thumb_float_child & 1) != 0);
+    g_thumb_result = 0.0f;
+    rc = Create(7, &test_thumb_float_child);
+    assertv(rc, rc >= 0);
+    assert(g_thumb_result == 4.875f);
+}
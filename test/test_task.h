@@ -0,0 +1,7 @@
+#ifdef TEST_TASK_H
+#error "double-included test_task.h"
+#endif
+
+#define TEST_TASK_H
+
+void test_task_all(void);
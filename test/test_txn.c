@@ -0,0 +1,254 @@
+#include "test/test_txn.h"
+
+#include "config.h"
+#include "xbool.h"
+#include "xint.h"
+#include "xdef.h"
+#include "static_assert.h"
+#include "u_tid.h"
+#include "task.h"
+#include "event.h"
+#include "kern.h"
+
+#include "xassert.h"
+#include "u_syscall.h"
+#include "ns.h"
+#include "clock_srv.h"
+
+#include "xarg.h"
+#include "bwio.h"
+
+#define TEST(init) test_txn_kern(#init, &init)
+
+#define TXN_N 3
+
+static void test_txn_kern(const char *name, void (*)(void));
+
+static void test_txn_parallel(void);
+static void test_txn_reorder(void);
+static void test_txn_errors(void);
+static void test_txn_server_exit(void);
+static void test_txn_clock(void);
+
+static void txn_echo(void);
+static void txn_reverse(void);
+static void txn_quitter(void);
+static void txn_delayer(void);
+
+static int g_delayed;
+
+void
+test_txn_all(void)
+{
+    TEST(test_txn_parallel);
+    TEST(test_txn_reorder);
+    TEST(test_txn_errors);
+    TEST(test_txn_server_exit);
+    TEST(test_txn_clock);
+}
+
+static void
+test_txn_kern(const char *name, void (*init)(void))
+{
+    struct kparam kp = { .init = init, .init_prio = 8, .show_top = false };
+    bwprintf("%s...", name);
+    kern_main(&kp);
+    bwputstr("ok\n\r");
+}
+
+/* Replies with the request plus one, forever */
+static void
+txn_echo(void)
+{
+    tid_t tid;
+    int x, rc;
+    for (;;) {
+        rc = Receive(&tid, &x, sizeof (x));
+        assertv(rc, rc == sizeof (x));
+        assert(IS_TXN_TID(tid));
+        x++;
+        rc = Reply(tid, &x, sizeof (x));
+        assertv(rc, rc == 0);
+    }
+}
+
+/* One request to each of three servers, all in flight at once */
+static void
+test_txn_parallel(void)
+{
+    int handles[TXN_N], rply[TXN_N], req[TXN_N], result;
+    int i, n, rc;
+    tid_t srv;
+
+    for (i = 0; i < TXN_N; i++) {
+        srv = Create(9, &txn_echo);
+        assertv(srv, srv >= 0);
+        req[i]     = 10 * i;
+        handles[i] = SendAsync(srv, &req[i], sizeof (req[i]),
+            &rply[i], sizeof (rply[i]));
+        assert(handles[i] >= 0);
+    }
+
+    /* The servers only get to run once we wait */
+    for (n = 0; n < TXN_N; n++) {
+        i = AwaitReply(handles, TXN_N, &result);
+        assertv(i, i >= 0 && i < TXN_N);
+        assert(result == sizeof (int));
+        assert(rply[i] == 10 * i + 1);
+        handles[i] = -1;
+    }
+    rc = AwaitReply(handles, TXN_N, NULL);
+    assertv(rc, rc == -1);
+}
+
+/* Receives all three before replying to any, in reverse order */
+static void
+txn_reverse(void)
+{
+    tid_t tids[TXN_N];
+    int i, rc;
+    for (i = 0; i < TXN_N; i++) {
+        rc = Receive(&tids[i], NULL, 0);
+        assertv(rc, rc == 0);
+    }
+    for (i = TXN_N - 1; i >= 0; i--) {
+        rc = Reply(tids[i], &i, sizeof (i));
+        assertv(rc, rc == 0);
+    }
+}
+
+static void
+test_txn_reorder(void)
+{
+    int handles[TXN_N], rply[TXN_N];
+    int i, rc;
+    tid_t srv;
+
+    srv = Create(9, &txn_reverse);
+    assertv(srv, srv >= 0);
+    for (i = 0; i < TXN_N; i++) {
+        handles[i] = SendAsync(srv, NULL, 0, &rply[i], sizeof (rply[i]));
+        assert(handles[i] >= 0);
+    }
+
+    /* Each reply wakes us before the server gets to the next one */
+    for (i = TXN_N - 1; i >= 0; i--) {
+        rc = AwaitReply(handles, TXN_N, NULL);
+        assertv(rc, rc == i);
+        assert(rply[i] == i);
+        handles[i] = -1;
+    }
+}
+
+static void
+test_txn_errors(void)
+{
+    int x = 0, h, result, rc;
+    tid_t srv;
+
+    assert(SendAsync(1 << 16, NULL, 0, NULL, 0) == -1);
+    assert(SendAsync(2, NULL, 0, NULL, 0) == -2);
+    assert(SendAsync(MyTid(), NULL, IPC_COPY_CHUNK + 1, NULL, 0) == -4);
+    assert(AwaitReply(NULL, 0, NULL) == -1);
+    assert(AwaitReply(&x, -1, NULL) == -1);
+
+    srv = Create(9, &txn_echo);
+    assertv(srv, srv >= 0);
+    h = SendAsync(srv, &x, sizeof (x), &x, sizeof (x));
+    assert(h >= 0);
+    assert(Send(TXN_TID(h), NULL, 0, NULL, 0) == -1);
+    rc = AwaitReply(&h, 1, &result);
+    assertv(rc, rc == 0);
+    assert(result == sizeof (x) && x == 1);
+
+    /* The handle is used up */
+    assert(AwaitReply(&h, 1, NULL) == -2);
+    assert(Reply(TXN_TID(h), NULL, 0) == -2);
+}
+
+/* Receives once, and exits without replying */
+static void
+txn_quitter(void)
+{
+    tid_t tid;
+    int rc;
+    rc = Receive(&tid, NULL, 0);
+    assertv(rc, rc == 0);
+}
+
+static void
+test_txn_server_exit(void)
+{
+    int handles[2], result, rc;
+    tid_t srv;
+
+    /* One received and dropped, one never received */
+    srv = Create(9, &txn_quitter);
+    assertv(srv, srv >= 0);
+    handles[0] = SendAsync(srv, NULL, 0, NULL, 0);
+    handles[1] = SendAsync(srv, NULL, 0, NULL, 0);
+    assert(handles[0] >= 0 && handles[1] >= 0);
+
+    rc = AwaitReply(handles, 2, &result);
+    assertv(rc, rc == 0 || rc == 1);
+    assert(result == -2);
+    handles[rc] = -1;
+    rc = AwaitReply(handles, 2, &result);
+    assertv(rc, rc == 0 || rc == 1);
+    assert(result == -2);
+}
+
+/* An ordinary Delay(), alongside the transactions */
+static void
+txn_delayer(void)
+{
+    struct clkctx clk;
+    int rc;
+    clkctx_init(&clk);
+    rc = Delay(&clk, 10);
+    assertv(rc, rc == CLOCK_OK);
+    g_delayed++;
+}
+
+/* Delays from transactions and from tasks are kept apart by the
+   clock server, though handles and task indices overlap */
+static void
+test_txn_clock(void)
+{
+    struct clkctx clk;
+    struct clkreq reqs[8];
+    int handles[8], result;
+    int i, n, rc;
+    tid_t tid;
+
+    g_delayed = 0;
+    tid = Create(7, &ns_main);
+    assertv(tid, tid == NS_TID);
+    tid = Create(6, &clksrv_main);
+    assertv(tid, tid >= 0);
+
+    /* These run until they block in Delay() */
+    for (i = 0; i < 4; i++) {
+        tid = Create(7, &txn_delayer);
+        assertv(tid, tid >= 0);
+    }
+
+    clkctx_init(&clk);
+    for (i = 0; i < 8; i++) {
+        handles[i] = DelayAsync(&clk, 1 + i, &reqs[i]);
+        assert(handles[i] >= 0);
+    }
+
+    for (n = 0; n < 8; n++) {
+        i = AwaitReply(handles, 8, &result);
+        assertv(i, i >= 0 && i < 8);
+        assert(result == sizeof (int));
+        assert(reqs[i].rply == CLOCK_OK);
+        handles[i] = -1;
+    }
+
+    rc = Delay(&clk, 10);
+    assertv(rc, rc == CLOCK_OK);
+    assert(g_delayed == 4);
+    Shutdown();
+}
@@ -0,0 +1,7 @@
+#ifdef TEST_TXN_H
+#error "double-included test_txn.h"
+#endif
+
+#define TEST_TXN_H
+
+void test_txn_all(void);
@@ -0,0 +1,156 @@
+/* Kernel path length stress test. Drives the system calls whose cost
+ * grows with the number of tasks, with every task descriptor in use,
+ * then prints the longest path seen for each kind of kernel entry.
+ * Needs KERN_WCET for the report. */
+
+#include "test/test_wcet.h"
+
+#include "config.h"
+#include "xbool.h"
+#include "xint.h"
+#include "xdef.h"
+#include "static_assert.h"
+#include "u_tid.h"
+#include "task.h"
+#include "event.h"
+#include "kern.h"
+
+#include "xassert.h"
+#include "u_syscall.h"
+#include "batch.h"
+
+#include "xarg.h"
+#include "bwio.h"
+
+#define WCET_ROUNDS 4
+#define WCET_LONG   (4 * IPC_COPY_CHUNK)
+
+static void wcet_stress(void);
+static int  wcet_spawn(int prio, void (*fn)(void));
+static void wcet_client(void);
+static void wcet_server(void);
+static void wcet_sender(void);
+static void wcet_receiver(void);
+
+static tid_t           g_tids[MAX_TASKS];
+static struct batch_op g_ops[MAX_TASKS];
+static tid_t           g_server;
+static char            g_long_msg[WCET_LONG];
+static char            g_long_rcv[WCET_LONG];
+static char            g_long_rply[WCET_LONG];
+
+void
+test_wcet(void)
+{
+    struct kparam kp = {
+        .init      = &wcet_stress,
+        .init_prio = 8,
+        .show_top  = false,
+        .show_wcet = true
+    };
+    bwputstr("test_wcet...\n\r");
+#ifndef KERN_WCET
+    bwputstr("  KERN_WCET is off, nothing will be recorded\n\r");
+#endif
+    kern_main(&kp);
+}
+
+static void
+wcet_stress(void)
+{
+    tid_t tid;
+    char buf[4];
+    int round, i, n, rc, full = -1;
+
+    for (round = 0; round < WCET_ROUNDS; round++) {
+        /* Every free descriptor becomes a client waiting on us */
+        n = wcet_spawn(7, &wcet_client);
+        assertv(full, full < 0 || n == full);
+        full = n;
+
+        /* Full sender queue, answered in one ReplyMulti() */
+        for (i = 0; i < n; i++)
+            Receive(&g_tids[i], buf, sizeof (buf));
+        rc = ReplyMulti(g_tids, n, "ok", 3);
+        assertv(rc, rc == n);
+
+        /* Long messages and replies, copied in chunks */
+        for (i = 0; i < n; i++) {
+            rc = Receive(&tid, g_long_rcv, WCET_LONG);
+            assertv(rc, rc == WCET_LONG);
+            Reply(tid, g_long_rply, WCET_LONG);
+        }
+
+        /* One Batch() that answers everybody; the clients then exit */
+        for (i = 0; i < n; i++) {
+            g_ops[i].op  = BATCH_REPLY;
+            g_ops[i].buf = NULL;
+            g_ops[i].len = 0;
+            Receive(&g_ops[i].tid, NULL, 0);
+        }
+        rc = Batch(g_ops, n);
+        assertv(rc, rc == 0);
+
+        /* Destroy a server with everybody queued on it */
+        g_server = Create(9, &wcet_server);
+        Receive(&tid, NULL, 0);
+        assert(tid == g_server);
+        n = wcet_spawn(7, &wcet_sender);
+        assertv(n, n == full - 1);
+        rc = Destroy(g_server);
+        assertv(rc, rc == 0);
+
+        /* Destroy a full table of blocked tasks */
+        n = wcet_spawn(7, &wcet_receiver);
+        assertv(n, n == full);
+        for (i = 0; i < n; i++) {
+            rc = Destroy(g_tids[i]);
+            assertv(rc, rc == 0);
+        }
+    }
+}
+
+/* Create tasks until the descriptors run out */
+static int
+wcet_spawn(int prio, void (*fn)(void))
+{
+    tid_t tid;
+    int n = 0;
+    while ((tid = Create(prio, fn)) >= 0)
+        g_tids[n++] = tid;
+    assert(tid == -2);
+    return n;
+}
+
+static void
+wcet_client(void)
+{
+    tid_t parent = MyParentTid();
+    char buf[4];
+    Send(parent, "hi", 3, buf, sizeof (buf));
+    MyTid();
+    Pass();
+    Send(parent, g_long_msg, WCET_LONG, g_long_rcv, WCET_LONG);
+    Send(parent, NULL, 0, NULL, 0);
+}
+
+/* Blocks on the parent, so never receives */
+static void
+wcet_server(void)
+{
+    Send(MyParentTid(), NULL, 0, NULL, 0);
+}
+
+static void
+wcet_sender(void)
+{
+    int rc = Send(g_server, NULL, 0, NULL, 0);
+    assertv(rc, rc == -2);
+}
+
+static void
+wcet_receiver(void)
+{
+    tid_t tid;
+    Receive(&tid, NULL, 0);
+}
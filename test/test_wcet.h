@@ -0,0 +1,7 @@
+#ifdef TEST_WCET_H
+#error "double-included test_wcet.h"
+#endif
+
+#define TEST_WCET_H
+
+void test_wcet(void);
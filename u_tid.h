@@ -24,4 +24,20 @@
 /* Define the TID type */
 typedef int tid_t;
 
+/* Pseudo-TIDs. Messages generated by the kernel for an interrupt
+ * (see EVT_MSG) appear to come from EVT_TID(irq). These never name a
+ * real task, so they can't be sent or replied to. */
+#define EVT_TID_BASE        0x10000
+#define EVT_TID(irq)        (EVT_TID_BASE | (irq))
+#define IS_EVT_TID(tid)     (((tid) & ~0xff) == EVT_TID_BASE)
+#define EVT_TID_IRQ(tid)    ((tid) & 0xff)
+
+/* A message sent with SendAsync() appears to come from TXN_TID(handle),
+ * where handle is the one SendAsync() returned. Reply() to it completes
+ * that transaction; it can't be sent to. */
+#define TXN_TID_BASE        0x20000
+#define TXN_TID(handle)     (TXN_TID_BASE | (handle))
+#define IS_TXN_TID(tid)     (((tid) & ~0xffff) == TXN_TID_BASE)
+#define TXN_TID_HANDLE(tid) ((tid) & 0xffff)
+
 #endif
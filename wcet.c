@@ -0,0 +1,114 @@
+/*******************************************************************************
+    Copyright 2014 Matthew Thiffault
+
+    This file is part of HeatheRTOS.
+
+    HeatheRTOS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    HeatheRTOS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with HeatheRTOS.  If not, see <http://www.gnu.org/licenses/>.
+
+*******************************************************************************/
+
+#include "config.h"
+#include "xint.h"
+#include "xdef.h"
+#include "wcet.h"
+#include "section.h"
+
+#ifdef KERN_WCET
+
+#include "xmemcpy.h"
+#include "bithack.h"
+#include "pmu.h"
+#include "bwio.h"
+
+/* Too big for on-chip RAM, and only written once per kernel entry */
+static struct wcet_stat wcet_stats[WCET_SLOTS] DDR_BSS;
+
+COLD void
+wcet_init(struct wcet *w)
+{
+    memset(wcet_stats, 0, sizeof (wcet_stats));
+    w->stats = wcet_stats;
+    w->slot  = WCET_NONE;
+    pmu_init();
+    w->start = pmu_cycles();
+}
+
+HOT void
+wcet_exit(struct wcet *w)
+{
+    struct wcet_stat *s;
+    uint32_t cycles, n;
+    int b;
+
+    cycles = pmu_cycles() - w->start;
+    if (w->slot == WCET_NONE)
+        return;
+
+    s = &w->stats[w->slot];
+    s->count++;
+    if (cycles > s->max)
+        s->max = cycles;
+
+    n = cycles >> WCET_SHIFT;
+    b = n <= 1 ? 0 : 31 - clz32(n);
+    if (b >= WCET_BUCKETS)
+        b = WCET_BUCKETS - 1;
+    if (s->hist[b] != 0xffff)
+        s->hist[b]++;
+}
+
+static COLD void
+wcet_print_slot(const struct wcet_stat *s)
+{
+    int b;
+    bwprintf("\t%u\t%u\t", s->count, s->max);
+    for (b = 0; b < WCET_BUCKETS; b++)
+        bwprintf(" %u", (unsigned)s->hist[b]);
+    bwputstr("\n\r");
+}
+
+COLD void
+wcet_print(const struct wcet *w)
+{
+    uint32_t worst = 0;
+    int i;
+
+    bwprintf("--------\n\rkernel paths (cycles; histogram from <%u, x2)\n\r",
+        1u << (WCET_SHIFT + 1));
+    bwputstr("PATH\tCOUNT\tMAX\tHISTOGRAM\n\r");
+    for (i = 0; i < WCET_SLOTS; i++) {
+        const struct wcet_stat *s = &w->stats[i];
+        if (s->count == 0)
+            continue;
+        if (i < WCET_IRQ)
+            bwprintf("swi %x", i - WCET_SWI);
+        else if (i < WCET_UNDEF)
+            bwprintf("irq %d", i - WCET_IRQ);
+        else if (i == WCET_UNDEF)
+            bwputstr("undef");
+        else
+            bwputstr("copy");
+        wcet_print_slot(s);
+        if (s->max > worst)
+            worst = s->max;
+    }
+
+    /* IRQs are masked for the whole of each path, so the longest one
+       bounds IRQ latency. Copied whole, a long message would instead
+       hold them off for a copy slice's time per IPC_COPY_CHUNK bytes. */
+    bwprintf("irq latency <= %u cycles (unchunked: +%u per %u bytes)\n\r",
+        worst, w->stats[WCET_COPY].max, IPC_COPY_CHUNK);
+}
+
+#endif
@@ -0,0 +1,116 @@
+/*******************************************************************************
+    Copyright 2014 Matthew Thiffault
+
+    This file is part of HeatheRTOS.
+
+    HeatheRTOS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    HeatheRTOS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with HeatheRTOS.  If not, see <http://www.gnu.org/licenses/>.
+
+*******************************************************************************/
+
+#ifndef WCET_H
+#define WCET_H
+
+#include "xint.h"
+#include "config.h"
+#include "syscall.h"
+#include "intr.h"
+
+/*
+ * Kernel path length statistics. With KERN_WCET defined, the cycles
+ * spent in the kernel are counted from the return out of ctx_switch()
+ * to the next call into it, and charged to the kind of kernel entry
+ * that started them: a system call number, the first IRQ serviced, an
+ * undefined instruction, or a slice of a long message copy. The fixed
+ * cost of the entry and exit code in ctx_switch.S is not included.
+ *
+ * Without KERN_WCET, all of this compiles to nothing.
+ */
+
+/* Power of two histogram buckets. Bucket 0 counts paths under
+ * 1 << (WCET_SHIFT + 1) cycles, bucket k paths in
+ * [1 << (WCET_SHIFT + k), 1 << (WCET_SHIFT + k + 1)), and the last
+ * bucket everything longer. */
+#define WCET_BUCKETS 12
+#define WCET_SHIFT   7
+
+/* Statistics slots */
+enum {
+    WCET_SWI   = 0,                        /* + syscall number */
+    WCET_IRQ   = WCET_SWI + SYSCALL_COUNT, /* + IRQ number */
+    WCET_UNDEF = WCET_IRQ + IRQ_COUNT,
+    WCET_COPY,
+    WCET_SLOTS,
+    WCET_NONE  = -1
+};
+
+struct wcet_stat {
+    uint32_t count;
+    uint32_t max;
+    uint16_t hist[WCET_BUCKETS]; /* saturates at 0xffff */
+};
+
+struct wcet {
+    uint32_t          start; /* cycle count on kernel entry */
+    int               slot;  /* what the cycles are charged to */
+    struct wcet_stat *stats; /* WCET_SLOTS entries, kept in DDR */
+};
+
+#ifdef KERN_WCET
+#include "pmu.h"
+
+/* Clear all statistics and start the cycle counter */
+void wcet_init(struct wcet *w);
+
+/* Print every slot that was used */
+void wcet_print(const struct wcet *w);
+
+/* Charge the cycles since wcet_enter() to the current slot */
+void wcet_exit(struct wcet *w);
+
+/* Kernel entry, at the return from ctx_switch() */
+static inline void
+wcet_enter(struct wcet *w)
+{
+    w->slot  = WCET_NONE;
+    w->start = pmu_cycles();
+}
+
+/* Set what this kernel entry is charged to */
+static inline void
+wcet_charge(struct wcet *w, int slot)
+{
+    w->slot = slot;
+}
+
+/* Close the current slice and start a new one charged to slot */
+static inline void
+wcet_split(struct wcet *w, int slot)
+{
+    wcet_exit(w);
+    wcet_enter(w);
+    wcet_charge(w, slot);
+}
+
+#else
+
+#define wcet_init(w)          ((void)(w))
+#define wcet_print(w)         ((void)(w))
+#define wcet_exit(w)          ((void)(w))
+#define wcet_enter(w)         ((void)(w))
+#define wcet_charge(w, slot)  ((void)(w), (void)(slot))
+#define wcet_split(w, slot)   ((void)(w), (void)(slot))
+
+#endif
+
+#endif
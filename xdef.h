@@ -32,4 +32,7 @@ typedef unsigned long size_t;
    in a structure */
 #define offsetof(st, m) ((size_t)(&((st*)0)->m))
 
+/* Keep the compiler from moving memory accesses across this point */
+#define barrier() __asm__ volatile ("" ::: "memory")
+
 #endif